@@ -0,0 +1,182 @@
+#include "Image.h"
+#include "SyntheticDocument.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+//Times the stages of the pipeline on synthetic documents of several sizes and with several thread counts.
+//Usage: Benchmark [-s 1240x1754,2480x3508] [-t 1,2,4] [-r repetitions] [-d textDensity] [-n noise] [-csv]
+
+struct Measurement
+{
+	std::string stage;
+	unsigned long int width;
+	unsigned long int height;
+	unsigned int threads;
+	double seconds;
+	/// <summary>
+	/// The bytes read and written by the stage, for the bandwidth column.
+	/// </summary>
+	std::uint64_t bytes;
+};
+
+/// <summary>
+/// Returns the best time of repetitions runs. setup runs before every run and is not timed.
+/// </summary>
+static double Time(int repetitions, const std::function<void()>& setup, const std::function<void()>& run)
+{
+	double best = 0;
+	for (int r = 0; r < repetitions; r++)
+	{
+		setup();
+		const auto start = std::chrono::steady_clock::now();
+		run();
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (r == 0 || seconds < best) best = seconds;
+	}
+	return best;
+}
+
+static std::vector<std::string> Split(const std::string& list)
+{
+	std::vector<std::string> parts;
+	std::stringstream stream(list);
+	std::string part;
+	while (std::getline(stream, part, ',')) if (!part.empty()) parts.push_back(part);
+	return parts;
+}
+
+static std::uint64_t FileSize(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	return file ? (std::uint64_t)file.tellg() : 0;
+}
+
+static void Print(const std::vector<Measurement>& measurements, bool csv)
+{
+	if (csv) std::cout << "stage,width,height,threads,ms,MPixel/s,MB/s\n";
+	else std::cout << std::left << std::setw(48) << "Stage" << std::setw(12) << "Size" << std::right << std::setw(8) << "Threads"
+		<< std::setw(12) << "ms" << std::setw(12) << "MPixel/s" << std::setw(12) << "MB/s" << "\n";
+
+	for (const Measurement& m : measurements)
+	{
+		const double pixels = (double)m.width * m.height;
+		const double mpixels = m.seconds > 0 ? pixels / m.seconds / 1e6 : 0;
+		const double mbytes = m.seconds > 0 ? m.bytes / m.seconds / 1e6 : 0;
+		if (csv)
+		{
+			std::cout << m.stage << "," << m.width << "," << m.height << "," << m.threads << "," << m.seconds * 1000 << "," << mpixels << "," << mbytes << "\n";
+			continue;
+		}
+		const std::string size = std::to_string(m.width) + "x" + std::to_string(m.height);
+		std::cout << std::left << std::setw(48) << m.stage << std::setw(12) << size << std::right << std::setw(8) << m.threads << std::fixed << std::setprecision(2)
+			<< std::setw(12) << m.seconds * 1000 << std::setw(12) << mpixels << std::setw(12) << mbytes << "\n";
+	}
+	std::cout.flush();
+}
+
+static void Run(const std::string& path, unsigned long int width, unsigned long int height, const std::vector<unsigned int>& threadCounts, int repetitions, std::vector<Measurement>& measurements)
+{
+	const std::uint64_t pixels = (std::uint64_t)width * height;
+	const std::uint64_t fileSize = FileSize(path);
+	auto add = [&](const std::string& stage, unsigned int threads, double seconds, std::uint64_t bytes)
+	{
+		measurements.push_back({ stage, width, height, threads, seconds, bytes });
+	};
+	auto nothing = []() {};
+
+	//Reading: the whole file is read, RGB and FUSED also write the RGB matrix.
+	add("ReadBMP24 (RGB)", 1, Time(repetitions, nothing, [&]() { Image image(path, Image::READMODE::RGB); }), fileSize);
+	add("ReadBMP24 (FUSED)", 1, Time(repetitions, nothing, [&]() { Image image(path, Image::READMODE::FUSED); }), fileSize);
+	add("ReadBMP24 (GREYSCALE)", 1, Time(repetitions, nothing, [&]() { Image image(path, Image::READMODE::GREYSCALE); }), fileSize);
+	add("ReadBMP24 (MAPPED, pages load on first use)", 1, Time(repetitions, nothing, [&]() { Image image(path, Image::READMODE::MAPPED); }), fileSize);
+
+	Image colour(path, Image::READMODE::RGB);
+	add("RGBtoGreyscale", 1, Time(repetitions, nothing, [&]() { colour.RGBtoGreyscale(); }), pixels * 4);
+
+	//GetGreyPixels invalidates the frequency cached by the conversion, so the pixels are really counted.
+	add("GetGreyScaleFrequency", 1, Time(repetitions, [&]() { colour.GetGreyPixels(); }, [&]() { colour.GetGreyScaleFrequency(); }), pixels);
+
+	Image grey(path, Image::READMODE::GREYSCALE);
+	Image work;
+	auto fresh = [&]() { work = grey; };
+	add("FindAndDeleteBackground", 1, Time(repetitions, fresh, [&]() { work.FindAndDeleteBackground(); }), pixels * 2);
+	for (unsigned int threads : threadCounts)
+	{
+		auto freshWithThreads = [&]() { work = grey; work.SetThreadCount(threads); };
+		add("FindAndDeleteBackgroundInZones", threads, Time(repetitions, freshWithThreads, [&]() { work.FindAndDeleteBackgroundInZones(); }), pixels * 2);
+		add("FindAndDeleteBackgroundInZonesWithZoneAmount", threads, Time(repetitions, freshWithThreads, [&]() { work.FindAndDeleteBackgroundInZonesWithZoneAmount(); }), pixels * 2);
+	}
+	add("CutOutGreys", 1, Time(repetitions, fresh, [&]() { work.CutOutGreys(GreyPixel(180), GreyPixel(254)); }), pixels * 2);
+
+	const std::string output = path + ".out.bmp";
+	add("WriteBMP24Greyscale", 1, Time(repetitions, fresh, [&]() { work.WriteBMP24Greyscale(output); }), fileSize);
+	std::remove(output.c_str());
+}
+
+int main(int args, char** cat)
+{
+	std::vector<std::string> sizes = { "1240x1754", "2480x3508", "4960x7016" };
+	std::vector<unsigned int> threadCounts = { 1 };
+	const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+	for (unsigned int threads = 2; threads <= hardwareThreads; threads *= 2) threadCounts.push_back(threads);
+	if (hardwareThreads > 1 && threadCounts.back() != hardwareThreads) threadCounts.push_back(hardwareThreads);
+	int repetitions = 5;
+	bool csv = false;
+	SyntheticDocument::Options options;
+
+	for (int i = 1; i < args; i++)
+	{
+		const std::string arg = cat[i];
+		if (arg == "-s" && i + 1 < args) sizes = Split(cat[++i]);
+		else if (arg == "-t" && i + 1 < args)
+		{
+			threadCounts.clear();
+			for (const std::string& count : Split(cat[++i])) threadCounts.push_back((unsigned int)std::atoi(count.c_str()));
+		}
+		else if (arg == "-r" && i + 1 < args) repetitions = std::max(std::atoi(cat[++i]), 1);
+		else if (arg == "-d" && i + 1 < args) options.textDensity = std::atof(cat[++i]);
+		else if (arg == "-n" && i + 1 < args) options.noise = std::atoi(cat[++i]);
+		else if (arg == "-csv") csv = true;
+		else
+		{
+			std::cerr << "Usage: Benchmark [-s 1240x1754,2480x3508] [-t 1,2,4] [-r repetitions] [-d textDensity] [-n noise] [-csv]" << std::endl;
+			return 2;
+		}
+	}
+
+	Image::SetVerbose(false);
+	std::vector<Measurement> measurements;
+	for (const std::string& size : sizes)
+	{
+		unsigned long int width = 0, height = 0;
+		if (std::sscanf(size.c_str(), "%lux%lu", &width, &height) != 2 || width == 0 || height == 0)
+		{
+			std::cerr << "Invalid size " << size << std::endl;
+			return 2;
+		}
+		options.width = width;
+		options.height = height;
+		const std::string path = "benchmark-" + size + ".bmp";
+		if (!SyntheticDocument::Write(path, options))
+		{
+			std::cerr << "Could not create " << path << std::endl;
+			return 1;
+		}
+		Run(path, width, height, threadCounts, repetitions, measurements);
+		std::remove(path.c_str());
+	}
+
+	Print(measurements, csv);
+	return 0;
+}
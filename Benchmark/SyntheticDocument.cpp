@@ -0,0 +1,55 @@
+#include "SyntheticDocument.h"
+#include "Image.h"
+#include <random>
+#include <algorithm>
+
+static unsigned char Clamp(int value)
+{
+	return (unsigned char)std::min(std::max(value, 0), 255);
+}
+
+bool SyntheticDocument::Write(const std::string& path, const Options& options)
+{
+	Image document(options.width, options.height);
+	PixelPlane<RGBPixel>& pixels = document.GetColourPixels();
+	if (!pixels.Allocate(options.width, options.height)) return false;
+
+	std::mt19937 random(options.seed);
+	std::uniform_int_distribution<int> noise(-options.noise, options.noise);
+	const RGBPixel& paper = options.background;
+
+	//Paper: the tint with a slow vertical shading (uneven lighting of the scanner) and per-pixel noise.
+	for (unsigned long int j = 0; j < options.height; j++)
+	{
+		const int shade = (int)(12.0 * j / options.height) - 6;
+		RGBPixel* row = pixels.Row(j);
+		for (unsigned long int i = 0; i < options.width; i++)
+		{
+			const int n = noise(random) + shade;
+			row[i].Set(Clamp(paper.Red() + n), Clamp(paper.Green() + n), Clamp(paper.Blue() + n));
+		}
+	}
+
+	//Text: lines between margins, every line is a sequence of words made of dark vertical strokes of varying darkness.
+	const unsigned long int lineHeight = std::max(options.height / 60, 4ul);
+	const unsigned long int margin = options.width / 12;
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	std::uniform_int_distribution<int> ink(20, 90);
+	for (unsigned long int top = options.height / 10; top + lineHeight < options.height - options.height / 10; top += 2 * lineHeight)
+	{
+		for (unsigned long int i = margin; i < options.width - margin; i++)
+		{
+			if ((i / (lineHeight * 3)) % 5 == 4) continue;     // Space between words.
+			if (unit(random) >= options.textDensity) continue;
+			const unsigned char darkness = (unsigned char)ink(random);
+			const unsigned long int strokeTop = top + (unsigned long int)(unit(random) * lineHeight / 4);
+			for (unsigned long int j = strokeTop; j < top + lineHeight; j++)
+			{
+				const int n = noise(random) / 2;
+				pixels.Row(j)[i].Set(Clamp(darkness + n), Clamp(darkness + n), Clamp(darkness + n + 10));
+			}
+		}
+	}
+
+	return document.WriteBMP24(path);
+}
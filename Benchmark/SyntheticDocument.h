@@ -0,0 +1,39 @@
+#pragma once
+
+#include "RGBPixel.h"
+#include <string>
+
+/// <summary>
+/// Generates scanned-looking documents for benchmarks: a tinted, noisy paper background with lines of dark "text" strokes on it.
+/// The same options always generate the same pixels.
+/// </summary>
+class SyntheticDocument
+{
+public:
+	struct Options
+	{
+		unsigned long int width = 2480;
+		unsigned long int height = 3508;
+		/// <summary>
+		/// The part of a text line covered by strokes, between 0 and 1.
+		/// </summary>
+		double textDensity = 0.25;
+		/// <summary>
+		/// The colour of the paper.
+		/// </summary>
+		RGBPixel background = RGBPixel(235, 228, 210);
+		/// <summary>
+		/// The largest deviation of a pixel from its colour, per component.
+		/// </summary>
+		int noise = 12;
+		unsigned int seed = 1;
+	};
+
+	/// <summary>
+	/// Generates a document and writes it as a 24 bit BMP file.
+	/// </summary>
+	/// <param name="path">The path of the file to create.</param>
+	/// <param name="options">What the document looks like.</param>
+	/// <returns>true if successful, false otherwise.</returns>
+	static bool Write(const std::string& path, const Options& options);
+};
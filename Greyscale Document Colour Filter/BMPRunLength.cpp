@@ -0,0 +1,122 @@
+#include "BMPRunLength.h"
+
+//Absolute runs are at least 3 pixels (counts 1 and 2 mean end of bitmap and delta) and at most 255.
+static const std::size_t minAbsolute = 3;
+static const std::size_t maxRun = 255;
+
+std::size_t BMPRunLength::EncodeRow(const unsigned char* indices, std::size_t count, int bitCount, unsigned char* destination)
+{
+	unsigned char* out = destination;
+	std::size_t x = 0;
+	while (x < count)
+	{
+		std::size_t run = 1;
+		while (x + run < count && run < maxRun && indices[x + run] == indices[x]) run++;
+		if (run >= 2)
+		{
+			*out++ = (unsigned char)run;
+			*out++ = bitCount == 4 ? (unsigned char)(indices[x] << 4 | indices[x]) : indices[x];
+			x += run;
+			continue;
+		}
+
+		//The absolute run lasts until a run of 3 equal pixels starts, which is cheaper encoded.
+		std::size_t literal = 0;
+		while (x + literal < count && literal < maxRun)
+		{
+			const std::size_t p = x + literal;
+			if (p + 2 < count && indices[p] == indices[p + 1] && indices[p] == indices[p + 2]) break;
+			literal++;
+		}
+		if (literal < minAbsolute)
+		{
+			for (std::size_t i = 0; i < literal; i++)
+			{
+				*out++ = 1;
+				*out++ = bitCount == 4 ? (unsigned char)(indices[x + i] << 4) : indices[x + i];
+			}
+			x += literal;
+			continue;
+		}
+
+		*out++ = 0;
+		*out++ = (unsigned char)literal;
+		std::size_t bytes;
+		if (bitCount == 4)
+		{
+			bytes = (literal + 1) / 2;
+			for (std::size_t i = 0; i < bytes; i++)
+			{
+				const unsigned char high = indices[x + 2 * i];
+				const unsigned char low = 2 * i + 1 < literal ? indices[x + 2 * i + 1] : 0;
+				*out++ = (unsigned char)(high << 4 | low);
+			}
+		}
+		else
+		{
+			bytes = literal;
+			for (std::size_t i = 0; i < bytes; i++) *out++ = indices[x + i];
+		}
+		if (bytes % 2 != 0) *out++ = 0;     // Absolute runs end on a 2 byte boundary.
+		x += literal;
+	}
+	*out++ = 0;
+	*out++ = 0;
+	return (std::size_t)(out - destination);
+}
+
+std::size_t BMPRunLength::EncodeEnd(unsigned char* destination)
+{
+	destination[0] = 0;
+	destination[1] = 1;
+	return 2;
+}
+
+bool BMPRunLength::Decode(const unsigned char* data, std::size_t length, int bitCount, unsigned long int width, unsigned long int height, unsigned char* indices)
+{
+	std::size_t p = 0;
+	unsigned long int x = 0;
+	unsigned long int y = 0;
+	auto put = [&](unsigned char index)
+	{
+		if (x < width && y < height) indices[(std::size_t)y * width + x] = index;
+		x++;
+	};
+
+	while (y < height)
+	{
+		if (p + 2 > length) return false;
+		const unsigned char count = data[p++];
+		const unsigned char value = data[p++];
+		if (count > 0)
+		{
+			//Encoded run: the 4 bit pixels alternate between the high and the low half of the byte.
+			for (unsigned int i = 0; i < count; i++) put(bitCount == 4 ? (unsigned char)(i % 2 == 0 ? value >> 4 : value & 0x0f) : value);
+			continue;
+		}
+		switch (value)
+		{
+		case 0:     // End of line.
+			x = 0;
+			y++;
+			break;
+		case 1:     // End of bitmap.
+			return true;
+		case 2:     // Delta: right and up.
+			if (p + 2 > length) return false;
+			x += data[p];
+			y += data[p + 1];
+			p += 2;
+			break;
+		default:    // Absolute run of value pixels.
+		{
+			const std::size_t bytes = bitCount == 4 ? (value + 1) / 2 : value;
+			if (p + bytes > length) return false;
+			for (unsigned int i = 0; i < value; i++) put(bitCount == 4 ? (unsigned char)(i % 2 == 0 ? data[p + i / 2] >> 4 : data[p + i / 2] & 0x0f) : data[p + i]);
+			p += bytes + bytes % 2;
+			break;
+		}
+		}
+	}
+	return true;
+}
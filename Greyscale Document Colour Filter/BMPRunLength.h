@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// The run-length encodings of indexed BMP files: BI_RLE8 (8 bits per pixel) and BI_RLE4 (4 bits per pixel).
+/// The pixels are palette indices, one byte per pixel on both sides (the 4 bit indices are packed and unpacked here).
+/// A row is a sequence of encoded runs (count, index) and absolute runs (0, count, indices..., padded to 2 bytes), closed by an end of line (0, 0).
+/// The whole bitmap is closed by an end of bitmap (0, 1).
+/// </summary>
+class BMPRunLength
+{
+public:
+	/// <summary>
+	/// The biCompression values of the encodings.
+	/// </summary>
+	static const std::uint32_t rle8 = 1;
+	static const std::uint32_t rle4 = 2;
+
+	/// <summary>
+	/// The most bytes an encoded bitmap can take, end of lines and end of bitmap included (every pixel a separate encoded run).
+	/// </summary>
+	static inline std::uint64_t MaxEncodedSize(unsigned long int width, unsigned long int height) { return ((std::uint64_t)width * 2 + 2) * height + 2; }
+
+	/// <summary>
+	/// Encodes a row, with the end of line.
+	/// Runs of equal pixels become encoded runs, stretches without runs of at least 3 pixels become absolute runs.
+	/// </summary>
+	/// <param name="indices">The palette indices of the row, one per byte (below 16 for 4 bits).</param>
+	/// <param name="count">The number of pixels in the row.</param>
+	/// <param name="bitCount">8 or 4.</param>
+	/// <param name="destination">Where to write, must have room for 2 * count + 2 bytes.</param>
+	/// <returns>The number of bytes written.</returns>
+	static std::size_t EncodeRow(const unsigned char* indices, std::size_t count, int bitCount, unsigned char* destination);
+	/// <summary>
+	/// Writes the end of bitmap.
+	/// </summary>
+	/// <returns>The number of bytes written (2).</returns>
+	static std::size_t EncodeEnd(unsigned char* destination);
+
+	/// <summary>
+	/// Decodes a bitmap. Pixels the data skips (delta, early end of line or bitmap) keep what indices had before.
+	/// Pixels beyond the edges of the bitmap are dropped.
+	/// </summary>
+	/// <param name="data">The encoded pixel data.</param>
+	/// <param name="length">The number of bytes of data.</param>
+	/// <param name="bitCount">8 or 4.</param>
+	/// <param name="width">The width of the bitmap.</param>
+	/// <param name="height">The height of the bitmap.</param>
+	/// <param name="indices">width * height palette indices, in file order (the first row is the bottom one).</param>
+	/// <returns>false if the data ends in the middle of a run, true otherwise.</returns>
+	static bool Decode(const unsigned char* data, std::size_t length, int bitCount, unsigned long int width, unsigned long int height, unsigned char* indices);
+};
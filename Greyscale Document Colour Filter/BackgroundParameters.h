@@ -0,0 +1,23 @@
+#pragma once
+
+/// <summary>
+/// The thresholds of the background detection (see Image::FindBackgroundStart).
+/// The background peak is the most frequent grey shade between peakMin and peakMax, the background starts
+/// at the first shade below the peak where the frequency falls under percent of the peak.
+/// </summary>
+struct BackgroundParameters
+{
+	/// <summary>
+	/// The share of the peak frequency that ends the background, between 0 and 1. Smaller values remove more shades.
+	/// About 0.015 gave the best result for peldaDok.bmp.
+	/// </summary>
+	double percent = 0.15;
+	/// <summary>
+	/// The first grey shade searched for the background peak.
+	/// </summary>
+	unsigned int peakMin = 150;
+	/// <summary>
+	/// The end of the peak search, the shade itself is not searched (at most 256).
+	/// </summary>
+	unsigned int peakMax = 250;
+};
@@ -0,0 +1,174 @@
+#include "BatchProcessor.h"
+#include "Image.h"
+#include "StripFilter.h"
+#include "ThreadPool.h"
+#include "PageArena.h"
+#include "ReadAhead.h"
+#include "WriteBehind.h"
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <atomic>
+#include <memory>
+
+BatchProcessor::BatchProcessor(unsigned int workers, int zoneSize)
+{
+	this->workers = workers;
+	this->zoneSize = zoneSize;
+}
+
+bool BatchProcessor::AddDirectory(const std::string& directory)
+{
+	std::error_code error;
+	std::filesystem::directory_iterator it(directory, error);
+	if (error) return false;
+
+	std::vector<std::string> files;
+	for (const std::filesystem::directory_entry& entry : it)
+	{
+		if (!entry.is_regular_file(error)) continue;
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		if (extension == ".bmp" || extension == ".pgm" || extension == ".ppm" || extension == ".pbm" || extension == ".pnm") files.push_back(entry.path().string());
+	}
+	std::sort(files.begin(), files.end());
+	inputs.insert(inputs.end(), files.begin(), files.end());
+	return true;
+}
+
+bool BatchProcessor::AddManifest(const std::string& manifest)
+{
+	std::ifstream file(manifest);
+	if (!file) return false;
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+		if (line.empty() || line[0] == '#') continue;
+		inputs.push_back(line);
+	}
+	return true;
+}
+
+std::string BatchProcessor::OutputPath(const std::string& input) const
+{
+	const std::filesystem::path path(input);
+	const std::filesystem::path directory = outputDirectory.empty() ? path.parent_path() : std::filesystem::path(outputDirectory);
+	const char* extension = stripMode ? ".bmp" : outputFormat == Image::IMAGEFORMAT::PGM ? ".pgm" : outputFormat == Image::IMAGEFORMAT::PBM ? ".pbm" : ".bmp";
+	return (directory / (path.stem().string() + "-backroundRemoved" + extension)).string();
+}
+
+BatchProcessor::Result BatchProcessor::Process(std::size_t index, ArenaPool& arenas, ReadAhead* readAhead, WriteBehind* writeBehind) const
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::string& input = inputs[index];
+
+	Result result;
+	result.input = input;
+	result.output = OutputPath(input);
+
+	if (stripMode)
+	{
+		StripFilter filter(zoneSize, greyFormula);
+		filter.SetBackgroundParameters(backgroundParameters);
+		result.success = filter.Run(input, result.output);
+		result.width = filter.GetWidth();
+		result.height = filter.GetHeight();
+		result.originalToner = filter.OriginalTonerUsage();
+		result.toner = filter.TonerUsage();
+	}
+	else
+	{
+		//Every buffer of the page comes from an arena that is reset and reused for the next page of the worker.
+		std::unique_ptr<PageArena> arena = arenas.Acquire();
+		{
+			MappedFile contents;
+			if (readAhead != nullptr) contents = readAhead->Take(index);
+			Image image(input, std::move(contents), Image::READMODE::GREYSCALE, arena.get(), greyFormula);
+			image.UseWriteBehind(writeBehind);
+			if (image.HasPixels())
+			{
+				//The documents already keep every worker busy, the zones of one document don't need more threads.
+				image.SetThreadCount(1);
+				image.SetSampling(samplingStep);
+				image.SetBackgroundParameters(backgroundParameters);
+				result.width = image.GetWidth();
+				result.height = image.GetHeight();
+				if (slidingWindow) image.FindAndDeleteBackgroundSliding(zoneSize);
+				else image.FindAndDeleteBackgroundInZones(zoneSize);
+				result.success = image.WriteGreyscale(result.output, outputFormat);
+				result.originalToner = image.OriginalTonerUsage();
+				result.toner = image.CurrentTonerUsage();
+				result.stats = image.GetStats();
+			}
+		}
+		arenas.Return(std::move(arena));
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+std::vector<BatchProcessor::Result> BatchProcessor::Run() const
+{
+	std::vector<Result> results(inputs.size());
+	if (!outputDirectory.empty())
+	{
+		std::error_code error;
+		std::filesystem::create_directories(outputDirectory, error);
+	}
+
+	const bool async = readAheadDocuments > 0 && !stripMode;
+	std::unique_ptr<ReadAhead> readAhead(async ? new ReadAhead(inputs, readAheadDocuments, asyncBytes) : nullptr);
+	std::unique_ptr<WriteBehind> writeBehind(async ? new WriteBehind(asyncBytes) : nullptr);
+
+	//Every worker takes the next document until there are none left, the pool never runs more than its thread count at once, so the memory used is bounded by the largest documents.
+	//The documents are started in order, the read ahead loads them in the same order.
+	ThreadPool pool(workers);
+	ArenaPool arenas;
+	std::atomic<std::size_t> next(0);
+	pool.ParallelFor(pool.GetThreadCount(), [this, &results, &arenas, &next, &readAhead, &writeBehind](std::size_t)
+	{
+		for (std::size_t i = next++; i < inputs.size(); i = next++) results[i] = Process(i, arenas, readAhead.get(), writeBehind.get());
+	}, 1);
+
+	if (writeBehind != nullptr)
+	{
+		const std::vector<std::string> failed = writeBehind->Flush();
+		for (Result& result : results)
+		{
+			if (std::find(failed.begin(), failed.end(), result.output) != failed.end()) result.success = false;
+		}
+	}
+	return results;
+}
+
+void BatchProcessor::WriteSummary(std::ostream& stream, const std::vector<Result>& results)
+{
+	stream << "input,output,status,width,height,original toner,toner,saved percent,seconds\n";
+	for (const Result& result : results)
+	{
+		const double saved = result.originalToner > 0 ? (result.originalToner - result.toner) / result.originalToner * 100 : 0;
+		stream << result.input << "," << result.output << "," << (result.success ? "ok" : "failed") << ","
+			<< result.width << "," << result.height << ","
+			<< result.originalToner << "," << result.toner << "," << saved << "," << result.seconds << "\n";
+	}
+	stream.flush();
+}
+
+void BatchProcessor::WriteStats(std::ostream& stream, const std::vector<Result>& results)
+{
+	for (const Result& result : results)
+	{
+		stream << "{\"input\":";
+		ImageStats::WriteJSONString(stream, result.input);
+		stream << ",\"status\":\"" << (result.success ? "ok" : "failed") << "\",\"width\":" << result.width << ",\"height\":" << result.height
+			<< ",\"seconds\":" << result.seconds << ",\"stages\":";
+		result.stats.WriteJSON(stream);
+		stream << "}\n";
+	}
+	stream.flush();
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "ImageStats.h"
+#include "Image.h"
+
+class ArenaPool;
+class ReadAhead;
+class WriteBehind;
+
+/// <summary>
+/// Runs the read, background removal, write and toner report pipeline over many documents in one process.
+/// The documents are processed concurrently on a bounded number of worker threads, every document is processed by a single thread
+/// (one document per thread keeps all the cores busy without the per-zone synchronisation of a parallel single image).
+/// </summary>
+class BatchProcessor
+{
+public:
+	/// <summary>
+	/// The summary of one processed document.
+	/// </summary>
+	struct Result
+	{
+		std::string input;
+		std::string output;
+		bool success = false;
+		unsigned long int width = 0;
+		unsigned long int height = 0;
+		double originalToner = 0;
+		double toner = 0;
+		double seconds = 0;
+		/// <summary>
+		/// The per-stage statistics of the document (empty in strip mode).
+		/// </summary>
+		ImageStats stats;
+	};
+
+private:
+	std::vector<std::string> inputs;
+	std::string outputDirectory = "";
+	unsigned int workers;
+	int zoneSize;
+	bool stripMode = false;
+	bool slidingWindow = false;
+	unsigned int samplingStep = 1;
+	BackgroundParameters backgroundParameters;
+	std::size_t readAheadDocuments = 0;
+	std::uint64_t asyncBytes = 0;
+	Image::IMAGEFORMAT outputFormat = Image::IMAGEFORMAT::BMP24;
+	GreyConversion::FORMULA greyFormula = GreyConversion::FORMULA::WEIGHTED;
+
+	Result Process(std::size_t index, ArenaPool& arenas, ReadAhead* readAhead, WriteBehind* writeBehind) const;
+	std::string OutputPath(const std::string& input) const;
+
+public:
+	/// <summary>
+	/// Constructor.
+	/// </summary>
+	/// <param name="workers">The number of documents processed at the same time. 0 means one per hardware thread.</param>
+	/// <param name="zoneSize">The width and height of a single zone of the background removal.</param>
+	BatchProcessor(unsigned int workers = 0, int zoneSize = 100);
+
+	/// <summary>
+	/// Adds a single file to the batch.
+	/// </summary>
+	inline void AddFile(const std::string& file) { inputs.push_back(file); }
+	/// <summary>
+	/// Adds every .bmp, .pgm, .ppm, .pbm and .pnm file of a directory (not recursive) to the batch, in name order.
+	/// </summary>
+	/// <param name="directory">The path of the directory.</param>
+	/// <returns>true if the directory could be listed, false otherwise.</returns>
+	bool AddDirectory(const std::string& directory);
+	/// <summary>
+	/// Adds the files listed in a manifest to the batch. One path per line, empty lines and lines starting with # are skipped.
+	/// </summary>
+	/// <param name="manifest">The path of the manifest file.</param>
+	/// <returns>true if the manifest could be read, false otherwise.</returns>
+	bool AddManifest(const std::string& manifest);
+	inline std::size_t GetDocumentCount() const { return inputs.size(); }
+
+	/// <summary>
+	/// Sets the directory the results are written to. Empty (default): next to the input files.
+	/// The result of name.bmp is name-backroundRemoved.bmp (.pgm or .pbm for those output formats).
+	/// </summary>
+	inline void SetOutputDirectory(const std::string& directory) { outputDirectory = directory; }
+	/// <summary>
+	/// Process the documents with StripFilter instead of loading them whole. Uses memory proportional to the width of a document only.
+	/// </summary>
+	inline void UseStripMode(bool enable) { stripMode = enable; }
+	/// <summary>
+	/// Remove the background with a window of zoneSize sliding over every pixel instead of fixed zones. Seam-free, but slower. Ignored in strip mode.
+	/// </summary>
+	inline void UseSlidingWindow(bool enable) { slidingWindow = enable; }
+	/// <summary>
+	/// Sets the format of the results: BMP24 (default), BMP8, BMP1, RLE8, RLE4, PGM or PBM. Strip mode only reads BMP files and always writes BMP24.
+	/// </summary>
+	inline void SetOutputFormat(Image::IMAGEFORMAT format) { outputFormat = format; }
+	/// <summary>
+	/// Sets the grey conversion formula of every document. Default: WEIGHTED (Rec. 709).
+	/// </summary>
+	inline void SetGreyFormula(GreyConversion::FORMULA formula) { greyFormula = formula; }
+	/// <summary>
+	/// Sets the background peak search window and falloff of every document, see Image::SetBackgroundParameters. Default: BackgroundParameters().
+	/// </summary>
+	inline void SetBackgroundParameters(const BackgroundParameters& parameters) { backgroundParameters = parameters; }
+	/// <summary>
+	/// Estimates the background of every document from 1 in step * step pixels, see Image::SetSampling. Default: 1, every pixel. Ignored in strip and sliding window modes.
+	/// </summary>
+	inline void SetSampling(unsigned int step) { samplingStep = step; }
+	/// <summary>
+	/// Overlaps the I/O with the processing: a background thread loads the next documents while the current ones are processed,
+	/// another one writes the results while the next ones are processed. Ignored in strip mode.
+	/// </summary>
+	/// <param name="documents">The most documents loaded ahead. 0 (default): synchronous reads and writes.</param>
+	/// <param name="maxBytes">The most memory the loaded documents use together, and separately the results waiting to be written.</param>
+	inline void UseAsyncIO(std::size_t documents, std::uint64_t maxBytes = 256ull << 20) { readAheadDocuments = documents; asyncBytes = maxBytes; }
+
+	/// <summary>
+	/// Processes every document of the batch.
+	/// The documents are started in the order they were added.
+	/// </summary>
+	/// <returns>The summary of every document, in the order they were added.</returns>
+	std::vector<Result> Run() const;
+
+	/// <summary>
+	/// Writes the summaries as CSV, one line per document.
+	/// </summary>
+	/// <param name="stream">The stream to write to.</param>
+	/// <param name="results">The summaries returned by Run.</param>
+	static void WriteSummary(std::ostream& stream, const std::vector<Result>& results);
+	/// <summary>
+	/// Writes the per-stage statistics as JSON lines, one line per document.
+	/// </summary>
+	/// <param name="stream">The stream to write to.</param>
+	/// <param name="results">The summaries returned by Run.</param>
+	static void WriteStats(std::ostream& stream, const std::vector<Result>& results);
+};
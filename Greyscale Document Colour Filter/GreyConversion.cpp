@@ -0,0 +1,284 @@
+#include "GreyConversion.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define GREYCONVERSION_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#define TARGET_AVX512
+#else
+#include <cpuid.h>
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif
+#endif
+
+static_assert(sizeof(RGBPixel) == 3, "RGBPixel must be 3 bytes (Blue, Green, Red).");
+static_assert(GreyConversion::redWeight + GreyConversion::greenWeight + GreyConversion::blueWeight == 1 << GreyConversion::weightShift, "The weights must sum up to 1.");
+
+typedef void (*ConvertKernel)(const unsigned char* source, unsigned char* destination, std::size_t count);
+
+//Scalar kernel, also used for the tails the SIMD kernels leave. The formula policy is a template parameter, so every formula gets its own loop.
+template <class Formula>
+static void ConvertScalar(const unsigned char* source, unsigned char* destination, std::size_t count)
+{
+	GreyConversion::ConvertRow<Formula>((const RGBPixel*)source, (GreyPixel*)destination, count);
+}
+
+#ifdef GREYCONVERSION_X86
+//All kernels work the same way on 4 pixels (12 bytes) of a 128 bit lane:
+//  1. The bytes are shuffled into 16 bit blue-green pairs and 16 bit red-zero pairs.
+//  2. For the weighted formulas the pairs are multiplied by the weights and added (madd) into 32 bit sums, then shifted.
+//     For the average formula every component is divided by 3 first (x / 3 == (x * 21888) >> 16 for 0-255) and then added.
+//  3. The 32 bit results are packed back into bytes.
+//The kernels are instantiated for the Weights policies (whose weights fit in 16 bits) and Average3, the single channel formulas stay scalar.
+//The lanes are loaded 12 bytes apart so every kernel reads up to 4 bytes past the last pixel it converts, the loop conditions leave room for that.
+
+static const int averageMultiplier = 21888;
+
+template <class Formula>
+TARGET_SSSE3 static inline __m128i Grey4SSSE3(__m128i pixels)
+{
+	const __m128i blueGreenMask = _mm_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+	const __m128i redMask = _mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+	__m128i blueGreen = _mm_shuffle_epi8(pixels, blueGreenMask);
+	__m128i red = _mm_shuffle_epi8(pixels, redMask);
+	if constexpr (Formula::weighted)
+	{
+		const __m128i blueGreenWeights = _mm_set1_epi32((Formula::green << 16) | Formula::blue);
+		const __m128i redWeights = _mm_set1_epi32(Formula::red);
+		__m128i sum = _mm_add_epi32(_mm_madd_epi16(blueGreen, blueGreenWeights), _mm_madd_epi16(red, redWeights));
+		return _mm_srli_epi32(sum, GreyConversion::weightShift);
+	}
+	const __m128i third = _mm_set1_epi16(averageMultiplier);
+	const __m128i ones = _mm_set1_epi32(0x00010001);
+	blueGreen = _mm_madd_epi16(_mm_mulhi_epu16(blueGreen, third), ones);
+	red = _mm_mulhi_epu16(red, third);
+	return _mm_add_epi32(blueGreen, red);
+}
+
+template <class Formula>
+TARGET_SSSE3 static void ConvertSSSE3(const unsigned char* source, unsigned char* destination, std::size_t count)
+{
+	std::size_t i = 0;
+	for (; i + 18 <= count; i += 16)
+	{
+		const unsigned char* p = source + 3 * i;
+		const __m128i g0 = Grey4SSSE3<Formula>(_mm_loadu_si128((const __m128i*)(p)));
+		const __m128i g1 = Grey4SSSE3<Formula>(_mm_loadu_si128((const __m128i*)(p + 12)));
+		const __m128i g2 = Grey4SSSE3<Formula>(_mm_loadu_si128((const __m128i*)(p + 24)));
+		const __m128i g3 = Grey4SSSE3<Formula>(_mm_loadu_si128((const __m128i*)(p + 36)));
+		const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(g0, g1), _mm_packs_epi32(g2, g3));
+		_mm_storeu_si128((__m128i*)(destination + i), packed);
+	}
+	ConvertScalar<Formula>(source + 3 * i, destination + i, count - i);
+}
+
+template <class Formula>
+TARGET_AVX2 static inline __m256i Grey8AVX2(const unsigned char* p)
+{
+	const __m256i pixels = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)), _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+	const __m256i blueGreenMask = _mm256_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1, 0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1);
+	const __m256i redMask = _mm256_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1, 2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1);
+	__m256i blueGreen = _mm256_shuffle_epi8(pixels, blueGreenMask);
+	__m256i red = _mm256_shuffle_epi8(pixels, redMask);
+	if constexpr (Formula::weighted)
+	{
+		const __m256i blueGreenWeights = _mm256_set1_epi32((Formula::green << 16) | Formula::blue);
+		const __m256i redWeights = _mm256_set1_epi32(Formula::red);
+		__m256i sum = _mm256_add_epi32(_mm256_madd_epi16(blueGreen, blueGreenWeights), _mm256_madd_epi16(red, redWeights));
+		return _mm256_srli_epi32(sum, GreyConversion::weightShift);
+	}
+	const __m256i third = _mm256_set1_epi16(averageMultiplier);
+	const __m256i ones = _mm256_set1_epi32(0x00010001);
+	blueGreen = _mm256_madd_epi16(_mm256_mulhi_epu16(blueGreen, third), ones);
+	red = _mm256_mulhi_epu16(red, third);
+	return _mm256_add_epi32(blueGreen, red);
+}
+
+template <class Formula>
+TARGET_AVX2 static void ConvertAVX2(const unsigned char* source, unsigned char* destination, std::size_t count)
+{
+	//Packing works inside the 128 bit lanes, the permute puts the 4 pixel groups back in order.
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	std::size_t i = 0;
+	for (; i + 34 <= count; i += 32)
+	{
+		const unsigned char* p = source + 3 * i;
+		const __m256i g0 = Grey8AVX2<Formula>(p);
+		const __m256i g1 = Grey8AVX2<Formula>(p + 24);
+		const __m256i g2 = Grey8AVX2<Formula>(p + 48);
+		const __m256i g3 = Grey8AVX2<Formula>(p + 72);
+		const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(g0, g1), _mm256_packs_epi32(g2, g3));
+		_mm256_storeu_si256((__m256i*)(destination + i), _mm256_permutevar8x32_epi32(packed, order));
+	}
+	ConvertSSSE3<Formula>(source + 3 * i, destination + i, count - i);
+}
+
+template <class Formula>
+TARGET_AVX512 static inline __m512i Grey16AVX512(const unsigned char* p)
+{
+	__m512i pixels = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*)p));
+	pixels = _mm512_inserti32x4(pixels, _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+	pixels = _mm512_inserti32x4(pixels, _mm_loadu_si128((const __m128i*)(p + 24)), 2);
+	pixels = _mm512_inserti32x4(pixels, _mm_loadu_si128((const __m128i*)(p + 36)), 3);
+	const __m512i blueGreenMask = _mm512_broadcast_i32x4(_mm_setr_epi8(0, -1, 1, -1, 3, -1, 4, -1, 6, -1, 7, -1, 9, -1, 10, -1));
+	const __m512i redMask = _mm512_broadcast_i32x4(_mm_setr_epi8(2, -1, -1, -1, 5, -1, -1, -1, 8, -1, -1, -1, 11, -1, -1, -1));
+	__m512i blueGreen = _mm512_shuffle_epi8(pixels, blueGreenMask);
+	__m512i red = _mm512_shuffle_epi8(pixels, redMask);
+	if constexpr (Formula::weighted)
+	{
+		const __m512i blueGreenWeights = _mm512_set1_epi32((Formula::green << 16) | Formula::blue);
+		const __m512i redWeights = _mm512_set1_epi32(Formula::red);
+		__m512i sum = _mm512_add_epi32(_mm512_madd_epi16(blueGreen, blueGreenWeights), _mm512_madd_epi16(red, redWeights));
+		return _mm512_srli_epi32(sum, GreyConversion::weightShift);
+	}
+	const __m512i third = _mm512_set1_epi16(averageMultiplier);
+	const __m512i ones = _mm512_set1_epi32(0x00010001);
+	blueGreen = _mm512_madd_epi16(_mm512_mulhi_epu16(blueGreen, third), ones);
+	red = _mm512_mulhi_epu16(red, third);
+	return _mm512_add_epi32(blueGreen, red);
+}
+
+template <class Formula>
+TARGET_AVX512 static void ConvertAVX512(const unsigned char* source, unsigned char* destination, std::size_t count)
+{
+	//After packing lane k holds the 4 pixel groups k, k + 4, k + 8, k + 12.
+	const __m512i order = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	std::size_t i = 0;
+	for (; i + 66 <= count; i += 64)
+	{
+		const unsigned char* p = source + 3 * i;
+		const __m512i g0 = Grey16AVX512<Formula>(p);
+		const __m512i g1 = Grey16AVX512<Formula>(p + 48);
+		const __m512i g2 = Grey16AVX512<Formula>(p + 96);
+		const __m512i g3 = Grey16AVX512<Formula>(p + 144);
+		const __m512i packed = _mm512_packus_epi16(_mm512_packs_epi32(g0, g1), _mm512_packs_epi32(g2, g3));
+		_mm512_storeu_si512((void*)(destination + i), _mm512_permutexvar_epi32(order, packed));
+	}
+	ConvertSSSE3<Formula>(source + 3 * i, destination + i, count - i);
+}
+
+static void Cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+{
+#ifdef _MSC_VER
+	__cpuidex((int*)registers, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static unsigned long long ReadXCR0()
+{
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	unsigned int eax, edx;
+	__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+GreyConversion::INSTRUCTIONSET GreyConversion::GetSupportedInstructionSet()
+{
+	INSTRUCTIONSET supported = INSTRUCTIONSET::SCALAR;
+#ifdef GREYCONVERSION_X86
+	unsigned int registers[4] = { 0, 0, 0, 0 };   //eax, ebx, ecx, edx
+	Cpuid(0, 0, registers);
+	const unsigned int maxLeaf = registers[0];
+
+	Cpuid(1, 0, registers);
+	const bool ssse3 = (registers[2] & (1u << 9)) != 0;
+	const bool osxsave = (registers[2] & (1u << 27)) != 0;
+	const bool avx = (registers[2] & (1u << 28)) != 0;
+	if (ssse3) supported = INSTRUCTIONSET::SSSE3;
+
+	//The wide registers can only be used if the operating system saves them on context switches.
+	if (!osxsave || !avx || maxLeaf < 7) return supported;
+	const unsigned long long xcr0 = ReadXCR0();
+	const bool ymmState = (xcr0 & 0x6) == 0x6;
+	const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+	Cpuid(7, 0, registers);
+	const bool avx2 = (registers[1] & (1u << 5)) != 0;
+	const bool avx512f = (registers[1] & (1u << 16)) != 0;
+	const bool avx512bw = (registers[1] & (1u << 30)) != 0;
+	if (avx2 && ymmState) supported = INSTRUCTIONSET::AVX2;
+	if (avx2 && avx512f && avx512bw && zmmState) supported = INSTRUCTIONSET::AVX512;
+#endif
+	return supported;
+}
+
+static GreyConversion::INSTRUCTIONSET& ActiveInstructionSet()
+{
+	static GreyConversion::INSTRUCTIONSET active = GreyConversion::GetSupportedInstructionSet();
+	return active;
+}
+
+GreyConversion::INSTRUCTIONSET GreyConversion::GetInstructionSet()
+{
+	return ActiveInstructionSet();
+}
+
+GreyConversion::INSTRUCTIONSET GreyConversion::SetInstructionSet(INSTRUCTIONSET instructionSet)
+{
+	const INSTRUCTIONSET supported = GetSupportedInstructionSet();
+	if (instructionSet > supported) instructionSet = supported;
+	return ActiveInstructionSet() = instructionSet;
+}
+
+const char* GreyConversion::InstructionSetName(INSTRUCTIONSET instructionSet)
+{
+	switch (instructionSet)
+	{
+	case INSTRUCTIONSET::SSSE3: return "SSSE3";
+	case INSTRUCTIONSET::AVX2: return "AVX2";
+	case INSTRUCTIONSET::AVX512: return "AVX-512";
+	default: return "scalar";
+	}
+}
+
+template <class Formula>
+static ConvertKernel SelectKernel()
+{
+#ifdef GREYCONVERSION_X86
+	switch (ActiveInstructionSet())
+	{
+	case GreyConversion::INSTRUCTIONSET::AVX512:
+		return ConvertAVX512<Formula>;
+	case GreyConversion::INSTRUCTIONSET::AVX2:
+		return ConvertAVX2<Formula>;
+	case GreyConversion::INSTRUCTIONSET::SSSE3:
+		return ConvertSSSE3<Formula>;
+	default:
+		break;
+	}
+#endif
+	return ConvertScalar<Formula>;
+}
+
+void GreyConversion::ConvertRow(const RGBPixel* source, GreyPixel* destination, std::size_t count, FORMULA formula)
+{
+	ConvertKernel kernel;
+	switch (formula)
+	{
+	case FORMULA::AVERAGE: kernel = SelectKernel<Average3>(); break;
+	case FORMULA::REC601: kernel = SelectKernel<Rec601>(); break;
+	case FORMULA::RED: kernel = ConvertScalar<Channel<2>>; break;
+	case FORMULA::GREEN: kernel = ConvertScalar<Channel<1>>; break;
+	case FORMULA::BLUE: kernel = ConvertScalar<Channel<0>>; break;
+	default: kernel = SelectKernel<Rec709>(); break;
+	}
+	kernel((const unsigned char*)source, (unsigned char*)destination, count);
+}
+
+unsigned char GreyConversion::Convert(const RGBPixel& colour, FORMULA formula)
+{
+	GreyPixel grey;
+	ConvertRow(&colour, &grey, 1, formula);
+	return grey.GetLuminance();
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include "RGBPixel.h"
+#include "GreyPixel.h"
+#include <cstddef>
+
+/// <summary>
+/// The contribution of every value of every channel to a grey shade (before the shift of the formula), indexed by the channel value.
+/// Generated at compile time for the formula policies of GreyConversion.
+/// </summary>
+struct GreyChannelTables
+{
+	unsigned int red[256];
+	unsigned int green[256];
+	unsigned int blue[256];
+
+	static constexpr GreyChannelTables Weighted(int redWeight, int greenWeight, int blueWeight)
+	{
+		GreyChannelTables tables{};
+		for (int v = 0; v < 256; v++)
+		{
+			tables.red[v] = (unsigned int)(redWeight * v);
+			tables.green[v] = (unsigned int)(greenWeight * v);
+			tables.blue[v] = (unsigned int)(blueWeight * v);
+		}
+		return tables;
+	}
+	static constexpr GreyChannelTables Thirds()
+	{
+		GreyChannelTables tables{};
+		for (int v = 0; v < 256; v++) tables.red[v] = tables.green[v] = tables.blue[v] = (unsigned int)(v / 3);
+		return tables;
+	}
+};
+
+/// <summary>
+/// Bulk RGB to greyscale conversion.
+/// Whole rows are converted with fixed-point SIMD kernels, the instruction set is selected at runtime.
+/// Every kernel gives exactly the same result as the scalar formulas below.
+/// The formulas are also available as compile-time policies (Rec709, Rec601, Average, Channel, Weights) for ConvertRow&lt;Formula&gt;,
+/// which compiles a conversion loop specialized for that one formula.
+/// </summary>
+class GreyConversion
+{
+public:
+	/// <summary>
+	/// AVERAGE: Red / 3 + Green / 3 + Blue / 3. WEIGHTED (REC709): 0.2126 * Red + 0.7152 * Green + 0.0722 * Blue.
+	/// REC601: 0.299 * Red + 0.587 * Green + 0.114 * Blue. RED, GREEN, BLUE: a single channel (for scans with a coloured cast or dropout colour).
+	/// </summary>
+	enum class FORMULA { AVERAGE, WEIGHTED, REC709 = WEIGHTED, REC601, RED, GREEN, BLUE };
+	enum class INSTRUCTIONSET { SCALAR = 0, SSSE3, AVX2, AVX512 };
+
+	/// <summary>
+	/// The weighted formula is 0.2126 * Red + 0.7152 * Green + 0.0722 * Blue in fixed-point.
+	/// The weights are scaled by 2^weightShift and sum up to exactly 2^weightShift, so white stays white.
+	/// </summary>
+	static const int weightShift = 15;
+	static const int redWeight = 6967;
+	static const int greenWeight = 23435;
+	static const int blueWeight = 2366;
+
+	/// <summary>
+	/// Converts a colour to greyscale with the weighted formula.
+	/// </summary>
+	/// <returns>The luminance value as a single number between 0-255.</returns>
+	inline static unsigned char Weighted(const unsigned char red, const unsigned char green, const unsigned char blue)
+	{
+		return (unsigned char)((redWeight * red + greenWeight * green + blueWeight * blue) >> weightShift);
+	}
+	/// <summary>
+	/// Converts a colour to greyscale with the average formula.
+	/// Red / 3 + Green / 3 + Blue / 3
+	/// </summary>
+	/// <returns>The luminance value as a single number between 0-255.</returns>
+	inline static unsigned char Average(const unsigned char red, const unsigned char green, const unsigned char blue)
+	{
+		return red / 3 + green / 3 + blue / 3;
+	}
+
+	/// <summary>
+	/// Formula policy: fixed-point weights scaled by 2^weightShift, they must sum up to exactly 2^weightShift so white stays white.
+	/// The contribution tables are generated at compile time.
+	/// </summary>
+	template <int RedWeight, int GreenWeight, int BlueWeight>
+	struct Weights
+	{
+		static_assert(RedWeight >= 0 && GreenWeight >= 0 && BlueWeight >= 0 && RedWeight + GreenWeight + BlueWeight == 1 << weightShift, "The weights must sum up to 1.");
+		static constexpr bool weighted = true;
+		static constexpr int red = RedWeight;
+		static constexpr int green = GreenWeight;
+		static constexpr int blue = BlueWeight;
+		static constexpr GreyChannelTables tables = GreyChannelTables::Weighted(RedWeight, GreenWeight, BlueWeight);
+		inline static unsigned char Convert(const unsigned char r, const unsigned char g, const unsigned char b)
+		{
+			return (unsigned char)((tables.red[r] + tables.green[g] + tables.blue[b]) >> weightShift);
+		}
+	};
+	/// <summary>
+	/// Formula policy: Red / 3 + Green / 3 + Blue / 3, every channel divided by a compile-time table.
+	/// </summary>
+	struct Average3
+	{
+		static constexpr bool weighted = false;
+		static constexpr GreyChannelTables tables = GreyChannelTables::Thirds();
+		inline static unsigned char Convert(const unsigned char r, const unsigned char g, const unsigned char b)
+		{
+			return (unsigned char)(tables.red[r] + tables.green[g] + tables.blue[b]);
+		}
+	};
+	/// <summary>
+	/// Formula policy: a single channel, 0 blue, 1 green, 2 red (the order of the bytes of an RGBPixel).
+	/// </summary>
+	template <int Index>
+	struct Channel
+	{
+		static_assert(Index >= 0 && Index < 3, "The channel index must be 0 (blue), 1 (green) or 2 (red).");
+		static constexpr bool weighted = false;
+		inline static unsigned char Convert(const unsigned char r, const unsigned char g, const unsigned char b)
+		{
+			return Index == 2 ? r : Index == 1 ? g : b;
+		}
+	};
+	typedef Weights<redWeight, greenWeight, blueWeight> Rec709;
+	typedef Weights<9798, 19235, 3735> Rec601;
+
+	/// <summary>
+	/// Converts count consecutive pixels to greyscale with a compile-time formula, with a loop specialized for it (scalar, no runtime dispatch).
+	/// </summary>
+	/// <typeparam name="Formula">Rec709, Rec601, Average3, Channel&lt;i&gt; or a Weights&lt;r, g, b&gt; of your own.</typeparam>
+	template <class Formula>
+	static void ConvertRow(const RGBPixel* source, GreyPixel* destination, std::size_t count)
+	{
+		const unsigned char* bytes = (const unsigned char*)source;
+		unsigned char* grey = (unsigned char*)destination;
+		for (std::size_t i = 0; i < count; i++) grey[i] = Formula::Convert(bytes[3 * i + 2], bytes[3 * i + 1], bytes[3 * i]);
+	}
+	/// <summary>
+	/// Converts a single colour with the given formula.
+	/// </summary>
+	static unsigned char Convert(const RGBPixel& colour, FORMULA formula = FORMULA::WEIGHTED);
+
+	/// <summary>
+	/// Converts count consecutive pixels to greyscale.
+	/// </summary>
+	/// <param name="source">The first RGB pixel.</param>
+	/// <param name="destination">The first greyscale pixel to be written.</param>
+	/// <param name="count">The number of pixels.</param>
+	/// <param name="formula">The conversion formula.</param>
+	static void ConvertRow(const RGBPixel* source, GreyPixel* destination, std::size_t count, FORMULA formula = FORMULA::WEIGHTED);
+
+	/// <summary>
+	/// Returns the best instruction set supported by both the CPU and the operating system.
+	/// </summary>
+	static INSTRUCTIONSET GetSupportedInstructionSet();
+	/// <summary>
+	/// Returns the instruction set ConvertRow uses.
+	/// </summary>
+	static INSTRUCTIONSET GetInstructionSet();
+	/// <summary>
+	/// Limits ConvertRow to the given instruction set (or the best supported one if that is lower).
+	/// Meant for testing and benchmarking, don't call it while a conversion is running.
+	/// </summary>
+	/// <returns>The instruction set that will actually be used.</returns>
+	static INSTRUCTIONSET SetInstructionSet(INSTRUCTIONSET instructionSet);
+	static const char* InstructionSetName(INSTRUCTIONSET instructionSet);
+};
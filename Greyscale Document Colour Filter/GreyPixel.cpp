@@ -10,12 +10,6 @@ unsigned char GreyPixel::GetLuminance() const
 	return luminance;
 }
 
-GreyPixel GreyPixel::operator=(const GreyPixel& Rhs)
-{
-	luminance = Rhs.luminance;
-	return *this;
-}
-
 bool GreyPixel::operator==(const GreyPixel &Rhs)
 {
 	return luminance == (Rhs).luminance;
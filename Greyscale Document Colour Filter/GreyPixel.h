@@ -26,7 +26,6 @@ public:
 
 	unsigned char GetLuminance() const;
 
-	GreyPixel operator=(const GreyPixel& Rhs);
 	bool operator==(const GreyPixel &Rhs);
 	bool operator!=(const GreyPixel &Rhs) { return !(this == &Rhs); }
 
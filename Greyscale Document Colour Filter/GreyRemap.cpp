@@ -0,0 +1,153 @@
+#include "GreyRemap.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GREYREMAP_SSE2
+#include <emmintrin.h>
+#endif
+
+static_assert(sizeof(GreyPixel) == 1, "GreyPixel must be a single byte.");
+
+GreyRemap::GreyRemap()
+{
+	Reset();
+}
+
+void GreyRemap::Reset()
+{
+	for (int i = 0; i < size; i++) table[i] = (unsigned char)i;
+	UpdateShape();
+}
+
+void GreyRemap::Map(const GreyPixel from, const GreyPixel to)
+{
+	table[from.GetLuminance()] = to.GetLuminance();
+	UpdateShape();
+}
+
+void GreyRemap::MapInterval(const GreyPixel minGrey, const GreyPixel maxGrey, const GreyPixel to)
+{
+	unsigned char min = minGrey.GetLuminance();
+	unsigned char max = maxGrey.GetLuminance();
+	if (max < min)
+	{
+		unsigned char tmp = min;
+		min = max;
+		max = tmp;
+	}
+	for (int i = min; i <= max; i++) table[i] = to.GetLuminance();
+	UpdateShape();
+}
+
+bool GreyRemap::IsIdentity() const
+{
+	return isIdentity;
+}
+
+void GreyRemap::UpdateShape()
+{
+	//Looks for the single run of changed shades that all map to the same value.
+	isInterval = false;
+	int first = 0;
+	while (first < size && table[first] == first) first++;
+	isIdentity = first == size;
+	if (isIdentity) return;
+	int last = size - 1;
+	while (table[last] == last) last--;
+
+	const unsigned char target = table[first];
+	for (int i = first; i <= last; i++)
+	{
+		//A shade inside the run that already has the target value is unaffected either way.
+		if (table[i] != target) return;
+	}
+	isInterval = true;
+	intervalMin = (unsigned char)first;
+	intervalMax = (unsigned char)last;
+	intervalTarget = target;
+}
+
+void GreyRemap::Apply(GreyPixel* pixels, std::size_t count) const
+{
+	if (isInterval)
+	{
+		ApplyInterval(pixels, count, intervalMin, intervalMax, intervalTarget);
+		return;
+	}
+	if (isIdentity) return;
+	unsigned char* data = (unsigned char*)pixels;
+	for (std::size_t i = 0; i < count; i++) data[i] = table[data[i]];
+}
+
+void GreyRemap::ApplyInterval(GreyPixel* pixels, std::size_t count, unsigned char min, unsigned char max, unsigned char target)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	std::size_t i = 0;
+	const unsigned char range = max - min;
+#ifdef GREYREMAP_SSE2
+	//A shade is inside the interval if (shade - min) is not larger than (max - min) as an unsigned number.
+	const __m128i vMin = _mm_set1_epi8((char)min);
+	const __m128i vRange = _mm_set1_epi8((char)range);
+	const __m128i vTarget = _mm_set1_epi8((char)target);
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i shades = _mm_loadu_si128((const __m128i*)(data + i));
+		const __m128i offset = _mm_sub_epi8(shades, vMin);
+		const __m128i inside = _mm_cmpeq_epi8(_mm_min_epu8(offset, vRange), offset);
+		const __m128i result = _mm_or_si128(_mm_and_si128(inside, vTarget), _mm_andnot_si128(inside, shades));
+		_mm_storeu_si128((__m128i*)(data + i), result);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		if ((unsigned char)(data[i] - min) <= range) data[i] = target;
+	}
+}
+
+unsigned long long int GreyRemap::WhitenFrom(GreyPixel* pixels, std::size_t count, unsigned char start, unsigned long long int* toner)
+{
+	unsigned char* data = (unsigned char*)pixels;
+	unsigned long long int saved = 0;
+	unsigned long long int used = 0;
+	std::size_t i = 0;
+#ifdef GREYREMAP_SSE2
+	//The toner of a shade is its complement, the sums of absolute differences from 0 add up 8 of them at once in 64 bits.
+	const __m128i vStart = _mm_set1_epi8((char)start);
+	const __m128i white = _mm_set1_epi8((char)0xff);
+	const __m128i zero = _mm_setzero_si128();
+	__m128i vSaved = zero;
+	__m128i vUsed = zero;
+	for (; i + 16 <= count; i += 16)
+	{
+		const __m128i shades = _mm_loadu_si128((const __m128i*)(data + i));
+		const __m128i deleted = _mm_cmpeq_epi8(_mm_max_epu8(shades, vStart), shades);     // shade >= start
+		const __m128i complement = _mm_xor_si128(shades, white);
+		vSaved = _mm_add_epi64(vSaved, _mm_sad_epu8(_mm_and_si128(complement, deleted), zero));
+		vUsed = _mm_add_epi64(vUsed, _mm_sad_epu8(complement, zero));
+		_mm_storeu_si128((__m128i*)(data + i), _mm_or_si128(shades, deleted));
+	}
+	unsigned long long int lanes[2];
+	_mm_storeu_si128((__m128i*)lanes, vSaved);
+	saved = lanes[0] + lanes[1];
+	_mm_storeu_si128((__m128i*)lanes, vUsed);
+	used = lanes[0] + lanes[1];
+#endif
+	for (; i < count; i++)
+	{
+		const unsigned char shade = data[i];
+		used += GreyPixel::maxValue - shade;
+		if (shade < start) continue;
+		saved += GreyPixel::maxValue - shade;
+		data[i] = GreyPixel::maxValue;
+	}
+	if (toner != nullptr) *toner += used;
+	return saved;
+}
+
+void GreyRemap::Apply(PixelPlane<GreyPixel>& plane, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
+{
+	if (maxWidth <= minWidth) return;
+	for (unsigned long int j = minHeight; j < maxHeight; j++)
+	{
+		Apply(plane.Row(j) + minWidth, maxWidth - minWidth);
+	}
+}
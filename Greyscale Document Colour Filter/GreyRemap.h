@@ -0,0 +1,92 @@
+#pragma once
+
+#include "GreyPixel.h"
+#include "PixelPlane.h"
+#include <cstddef>
+
+/// <summary>
+/// A 256 entry lookup table that maps every grey shade to a new one.
+/// The table is built once and then applied to a region in a single pass, no matter how many shades it changes.
+/// </summary>
+class GreyRemap
+{
+private:
+	static const int size = GreyPixel::maxValue + 1;
+
+	/// <summary>
+	/// The new value of every shade.
+	/// </summary>
+	unsigned char table[size];
+
+	bool isIdentity = true;
+	//If the table is the identity except for one interval mapped to one value the apply can be done with range compares instead of lookups.
+	bool isInterval = false;
+	unsigned char intervalMin = 0;
+	unsigned char intervalMax = 0;
+	unsigned char intervalTarget = 0;
+
+	void UpdateShape();
+
+public:
+	/// <summary>
+	/// Constructor. Creates the identity mapping.
+	/// </summary>
+	GreyRemap();
+
+	/// <summary>
+	/// Sets the mapping back to the identity.
+	/// </summary>
+	void Reset();
+
+	/// <summary>
+	/// Maps a single grey shade to another one.
+	/// </summary>
+	/// <param name="from">The grey shade to change.</param>
+	/// <param name="to">The grey shade it is changed to.</param>
+	void Map(const GreyPixel from, const GreyPixel to);
+	/// <summary>
+	/// Maps every grey shade between minGrey and maxGrey (inclusive) to the same grey shade.
+	/// </summary>
+	/// <param name="minGrey">The minimum grey shade to change.</param>
+	/// <param name="maxGrey">The maximum grey shade to change.</param>
+	/// <param name="to">The grey shade they are changed to.</param>
+	void MapInterval(const GreyPixel minGrey, const GreyPixel maxGrey, const GreyPixel to);
+
+	/// <summary>
+	/// Returns true if the mapping doesn't change any shade.
+	/// </summary>
+	bool IsIdentity() const;
+
+	inline GreyPixel operator[](const unsigned char luminance) const { return GreyPixel(table[luminance]); }
+
+	/// <summary>
+	/// Applies the mapping to count consecutive pixels.
+	/// </summary>
+	/// <param name="pixels">The first pixel.</param>
+	/// <param name="count">The number of pixels.</param>
+	void Apply(GreyPixel* pixels, std::size_t count) const;
+	/// <summary>
+	/// Sets the shades between min and max (inclusive, min not larger than max) of count consecutive pixels to target, without building a table.
+	/// </summary>
+	/// <param name="pixels">The first pixel.</param>
+	/// <param name="count">The number of pixels.</param>
+	static void ApplyInterval(GreyPixel* pixels, std::size_t count, unsigned char min, unsigned char max, unsigned char target);
+	/// <summary>
+	/// Sets the shades from start up of count consecutive pixels to white, and counts the toner they used.
+	/// </summary>
+	/// <param name="pixels">The first pixel.</param>
+	/// <param name="count">The number of pixels.</param>
+	/// <param name="start">The first shade set to white.</param>
+	/// <param name="toner">If not nullptr, the toner all the pixels used before is added to it.</param>
+	/// <returns>The toner saved: maxValue - shade units per pixel set to white.</returns>
+	static unsigned long long int WhitenFrom(GreyPixel* pixels, std::size_t count, unsigned char start, unsigned long long int* toner = nullptr);
+	/// <summary>
+	/// Applies the mapping to a rectangle of a pixel plane.
+	/// </summary>
+	/// <param name="plane">The greyscale pixels to modify.</param>
+	/// <param name="minWidth"> The width (x) position of the upper left corner of the rectangle.</param>
+	/// <param name="minHeight">The height (y) position of the upper left corner of the rectangle.</param>
+	/// <param name="maxWidth"> The width (x) position of the lower right corner of the rectangle.</param>
+	/// <param name="maxHeight">The height (y) position of the lower right corner of the rectangle.</param>
+	void Apply(PixelPlane<GreyPixel>& plane, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const;
+};
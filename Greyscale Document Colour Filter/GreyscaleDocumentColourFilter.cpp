@@ -1,9 +1,316 @@
 #include "Image.h"
+#include "BatchProcessor.h"
+#include "ParameterSweep.h"
 #include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+
+/// <summary>
+/// Batch mode: GreyscaleDocumentColourFilter [-j workers] [-z zoneSize] [-o outputDirectory] [-s summary.csv] [-stats stats.jsonl] [-b 24|8|1|rle8|rle4|pgm|pbm] [-g average|rec709|rec601|red|green|blue] [-strip] [-sliding] [-sample step] [-async documents] [-p percent] [-w peakMin-peakMax] (directory | @manifest | file.bmp | file.pgm | file.ppm)...
+/// Removes the background of every document and writes a CSV summary line per document (to the standard output without -s).
+/// -b sets the bits per pixel of the results: 24 (default), 8 bit grey palette, 1 bit black and white, run-length encoded 8 or 4 bit BMP, or PGM or PBM.
+/// -g selects the grey conversion formula (default rec709).
+/// -sliding removes the background with a zoneSize window centred on every pixel instead of fixed zones (no seams between the zones, but slower).
+/// -sample estimates the background of every zone from 1 in step * step pixels (faster, the estimation error is reported in the stats).
+/// -async loads the next documents and writes the results on background threads while the documents are processed.
+/// -stats writes the per-stage timings and counters of every document as JSON lines.
+/// -p and -w set the background falloff (default 0.15) and the background peak search window (default 150-250), see BackgroundParameters.
+///
+/// Sweep mode: GreyscaleDocumentColourFilter -sweep [-z zoneSizes] [-p percents] [-w windows] [-g formula] [-limit share] [-s sweep.csv] [-best output] [-b 24|8|1|rle8|rle4|pgm|pbm] file
+/// Evaluates every combination of the comma separated zone sizes, falloffs and peak windows (for example -z 50,100,200 -p 0.015,0.05,0.15 -w 150-250,100-250)
+/// on one decoded document, and writes a CSV line per combination (to the standard output without -s).
+/// -best writes the result of the combination that saves the most toner while whitening at most share (default 1) of the pixels that are not white.
+/// </summary>
+static bool IsImageFile(const std::string& path)
+{
+    const std::size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    const std::string extension = path.substr(dot + 1);
+    return extension == "bmp" || extension == "pgm" || extension == "ppm" || extension == "pbm" || extension == "pnm";
+}
+
+static std::vector<std::string> SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::size_t begin = 0;
+    while (begin <= list.size())
+    {
+        std::size_t end = list.find(',', begin);
+        if (end == std::string::npos) end = list.size();
+        if (end > begin) items.push_back(list.substr(begin, end - begin));
+        begin = end + 1;
+    }
+    return items;
+}
+
+static bool ParseWindow(const std::string& window, BackgroundParameters& parameters)
+{
+    const std::size_t dash = window.find('-');
+    if (dash == std::string::npos) return false;
+    const int peakMin = std::atoi(window.substr(0, dash).c_str());
+    const int peakMax = std::atoi(window.substr(dash + 1).c_str());
+    if (peakMin < 0 || peakMax <= peakMin || peakMax > GreyPixel::maxValue + 1) return false;
+    parameters.peakMin = (unsigned int)peakMin;
+    parameters.peakMax = (unsigned int)peakMax;
+    return true;
+}
+
+static bool ParseFormat(const std::string& bits, Image::IMAGEFORMAT& format)
+{
+    if (bits == "24") format = Image::IMAGEFORMAT::BMP24;
+    else if (bits == "8") format = Image::IMAGEFORMAT::BMP8;
+    else if (bits == "1") format = Image::IMAGEFORMAT::BMP1;
+    else if (bits == "rle8") format = Image::IMAGEFORMAT::RLE8;
+    else if (bits == "rle4") format = Image::IMAGEFORMAT::RLE4;
+    else if (bits == "pgm") format = Image::IMAGEFORMAT::PGM;
+    else if (bits == "pbm") format = Image::IMAGEFORMAT::PBM;
+    else return false;
+    return true;
+}
+
+static bool ParseFormula(const std::string& name, GreyConversion::FORMULA& formula)
+{
+    if (name == "average") formula = GreyConversion::FORMULA::AVERAGE;
+    else if (name == "rec709") formula = GreyConversion::FORMULA::REC709;
+    else if (name == "rec601") formula = GreyConversion::FORMULA::REC601;
+    else if (name == "red") formula = GreyConversion::FORMULA::RED;
+    else if (name == "green") formula = GreyConversion::FORMULA::GREEN;
+    else if (name == "blue") formula = GreyConversion::FORMULA::BLUE;
+    else return false;
+    return true;
+}
+
+static int RunSweep(int args, char** cat)
+{
+    std::vector<int> zoneSizes;
+    std::vector<double> percents;
+    std::vector<BackgroundParameters> windows;
+    GreyConversion::FORMULA formula = GreyConversion::FORMULA::WEIGHTED;
+    Image::IMAGEFORMAT format = Image::IMAGEFORMAT::BMP24;
+    double limit = 1;
+    std::string summaryFile = "";
+    std::string bestFile = "";
+    std::string input = "";
+
+    for (int i = 2; i < args; i++)
+    {
+        const std::string arg = cat[i];
+        if (arg == "-z" && i + 1 < args) for (const std::string& item : SplitList(cat[++i])) zoneSizes.push_back(std::atoi(item.c_str()));
+        else if (arg == "-p" && i + 1 < args) for (const std::string& item : SplitList(cat[++i])) percents.push_back(std::atof(item.c_str()));
+        else if (arg == "-w" && i + 1 < args)
+        {
+            for (const std::string& item : SplitList(cat[++i]))
+            {
+                BackgroundParameters window;
+                if (!ParseWindow(item, window))
+                {
+                    std::cerr << "A peak window must be peakMin-peakMax with 0 <= peakMin < peakMax <= 256." << std::endl;
+                    return 2;
+                }
+                windows.push_back(window);
+            }
+        }
+        else if (arg == "-g" && i + 1 < args)
+        {
+            if (!ParseFormula(cat[++i], formula))
+            {
+                std::cerr << "The grey formula must be average, rec709, rec601, red, green or blue." << std::endl;
+                return 2;
+            }
+        }
+        else if (arg == "-b" && i + 1 < args)
+        {
+            if (!ParseFormat(cat[++i], format))
+            {
+                std::cerr << "The output format must be 24, 8, 1, rle8, rle4, pgm or pbm." << std::endl;
+                return 2;
+            }
+        }
+        else if (arg == "-limit" && i + 1 < args) limit = std::atof(cat[++i]);
+        else if (arg == "-s" && i + 1 < args) summaryFile = cat[++i];
+        else if (arg == "-best" && i + 1 < args) bestFile = cat[++i];
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 2;
+        }
+        else input = arg;
+    }
+    if (zoneSizes.empty()) zoneSizes.push_back(100);
+    if (percents.empty()) percents.push_back(BackgroundParameters().percent);
+    if (windows.empty()) windows.push_back(BackgroundParameters());
+    for (int zoneSize : zoneSizes)
+    {
+        if (zoneSize <= 0)
+        {
+            std::cerr << "The zone size must be positive." << std::endl;
+            return 2;
+        }
+    }
+    if (input.empty())
+    {
+        std::cerr << "No document to sweep." << std::endl;
+        return 2;
+    }
+
+    Image::SetVerbose(false);
+    Image image(input, Image::READMODE::GREYSCALE, nullptr, formula);
+    if (!image.HasPixels())
+    {
+        std::cerr << "Could not read " << input << std::endl;
+        return 2;
+    }
+
+    ParameterSweep sweep;
+    sweep.AddGrid(zoneSizes, percents, windows);
+    const std::vector<ParameterSweep::Result> results = sweep.Run(image, &ThreadPool::Shared());
+    if (summaryFile.empty()) ParameterSweep::WriteCSV(std::cout, results);
+    else
+    {
+        std::ofstream summary(summaryFile);
+        ParameterSweep::WriteCSV(summary, results);
+    }
+
+    const std::size_t best = ParameterSweep::Best(results, limit);
+    if (best == results.size())
+    {
+        std::cerr << "No combination whitens at most " << limit << " of the pixels." << std::endl;
+        return 1;
+    }
+    const ParameterSweep::Combination& combination = results[best].combination;
+    std::cerr << "Best: zone size " << combination.zoneSize << ", percent " << combination.parameters.percent
+        << ", peak window " << combination.parameters.peakMin << "-" << combination.parameters.peakMax
+        << ", saves " << results[best].SavedPercentage() << "% of the toner." << std::endl;
+    if (!bestFile.empty())
+    {
+        //The histograms are recounted here, the sweep kept only the figures.
+        image.SetBackgroundParameters(combination.parameters);
+        image.FindAndDeleteBackgroundInZones(combination.zoneSize);
+        if (!image.WriteGreyscale(bestFile, format))
+        {
+            std::cerr << "Could not write " << bestFile << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int RunBatch(int args, char** cat)
+{
+    unsigned int workers = 0;
+    int zoneSize = 100;
+    std::string outputDirectory = "";
+    std::string summaryFile = "";
+    std::string statsFile = "";
+    bool stripMode = false;
+    bool slidingWindow = false;
+    int readAhead = 0;
+    int samplingStep = 1;
+    BackgroundParameters parameters;
+    Image::IMAGEFORMAT format = Image::IMAGEFORMAT::BMP24;
+    GreyConversion::FORMULA formula = GreyConversion::FORMULA::WEIGHTED;
+    std::vector<std::string> sources;
+
+    for (int i = 1; i < args; i++)
+    {
+        const std::string arg = cat[i];
+        if (arg == "-j" && i + 1 < args) workers = (unsigned int)std::atoi(cat[++i]);
+        else if (arg == "-z" && i + 1 < args) zoneSize = std::atoi(cat[++i]);
+        else if (arg == "-o" && i + 1 < args) outputDirectory = cat[++i];
+        else if (arg == "-s" && i + 1 < args) summaryFile = cat[++i];
+        else if (arg == "-stats" && i + 1 < args) statsFile = cat[++i];
+        else if (arg == "-b" && i + 1 < args)
+        {
+            if (!ParseFormat(cat[++i], format))
+            {
+                std::cerr << "The output format must be 24, 8, 1, rle8, rle4, pgm or pbm." << std::endl;
+                return 2;
+            }
+        }
+        else if (arg == "-g" && i + 1 < args)
+        {
+            if (!ParseFormula(cat[++i], formula))
+            {
+                std::cerr << "The grey formula must be average, rec709, rec601, red, green or blue." << std::endl;
+                return 2;
+            }
+        }
+        else if (arg == "-strip") stripMode = true;
+        else if (arg == "-sliding") slidingWindow = true;
+        else if (arg == "-p" && i + 1 < args) parameters.percent = std::atof(cat[++i]);
+        else if (arg == "-w" && i + 1 < args)
+        {
+            if (!ParseWindow(cat[++i], parameters))
+            {
+                std::cerr << "The peak window must be peakMin-peakMax with 0 <= peakMin < peakMax <= 256." << std::endl;
+                return 2;
+            }
+        }
+        else if (arg == "-sample" && i + 1 < args) samplingStep = std::atoi(cat[++i]);
+        else if (arg == "-async" && i + 1 < args) readAhead = std::atoi(cat[++i]);
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 2;
+        }
+        else sources.push_back(arg);
+    }
+    if (zoneSize <= 0)
+    {
+        std::cerr << "The zone size must be positive." << std::endl;
+        return 2;
+    }
+
+    BatchProcessor batch(workers, zoneSize);
+    batch.SetOutputDirectory(outputDirectory);
+    batch.UseStripMode(stripMode);
+    batch.UseSlidingWindow(slidingWindow);
+    batch.SetBackgroundParameters(parameters);
+    batch.SetSampling(samplingStep > 1 ? (unsigned int)samplingStep : 1);
+    if (readAhead > 0) batch.UseAsyncIO((std::size_t)readAhead);
+    batch.SetOutputFormat(format);
+    batch.SetGreyFormula(formula);
+    for (const std::string& source : sources)
+    {
+        bool added;
+        if (source[0] == '@') added = batch.AddManifest(source.substr(1));
+        else if (IsImageFile(source)) { batch.AddFile(source); added = true; }
+        else added = batch.AddDirectory(source);
+        if (!added)
+        {
+            std::cerr << "Could not read " << source << std::endl;
+            return 2;
+        }
+    }
+
+    Image::SetVerbose(false);
+    const std::vector<BatchProcessor::Result> results = batch.Run();
+
+    if (summaryFile.empty()) BatchProcessor::WriteSummary(std::cout, results);
+    else
+    {
+        std::ofstream summary(summaryFile);
+        BatchProcessor::WriteSummary(summary, results);
+    }
+    if (!statsFile.empty())
+    {
+        std::ofstream stats(statsFile);
+        BatchProcessor::WriteStats(stats, results);
+    }
+
+    std::size_t failed = 0;
+    for (const BatchProcessor::Result& result : results) if (!result.success) failed++;
+    std::cerr << results.size() - failed << " of " << results.size() << " documents processed." << std::endl;
+    return failed == 0 ? 0 : 1;
+}
 
 int main(int args, char** cat)
 {
-    Image* peldaDok = new Image("peldaDok.bmp");
+    if (args > 1 && std::string(cat[1]) == "-sweep") return RunSweep(args, cat);
+    if (args > 1) return RunBatch(args, cat);
+
+    Image* peldaDok = new Image("peldaDok.bmp", Image::READMODE::GREYSCALE);
 
     /*Image* bookLossless = new Image("book.png.bmp");
     Image* bookLossy = new Image("book.jpg.bmp");*/
@@ -22,10 +329,10 @@ int main(int args, char** cat)
     /*bookLossless->WriteFrequencyToCSV("lossless.csv");
     bookLossy->WriteFrequencyToCSV("lossy.csv");*/
 
-    /*std::vector<unsigned int*> frequencies;
-    frequencies.push_back(bookLossless->GetGreyScaleFrequency());
-    frequencies.push_back(bookLossy->GetGreyScaleFrequency());
-    Image::WriteFrequenciesToCSV("lossless-lossy.csv", frequencies);*/
+    /*Image::Frequency lossless = bookLossless->GetGreyScaleFrequency();
+    Image::Frequency lossy = bookLossy->GetGreyScaleFrequency();
+    Image::WriteFrequenciesToCSV("lossless-lossy.csv", { lossless.data(), lossy.data() });*/
 
+    delete peldaDok;
     return 1;
 }
\ No newline at end of file
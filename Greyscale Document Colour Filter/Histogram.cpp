@@ -0,0 +1,85 @@
+#include "Histogram.h"
+#include <cstring>
+#include <cstdint>
+
+Histogram::Accumulator::Accumulator()
+{
+	Clear();
+}
+
+void Histogram::Accumulator::Clear()
+{
+	std::memset(counts, 0, sizeof(counts));
+}
+
+//The pixels are loaded 8 at a time and split with shifts, one load instead of eight.
+//A SIMD register doesn't help beyond that: the increments are scattered, x86 has no byte scatter.
+
+void Histogram::Accumulator::Add(const GreyPixel* pixels, std::size_t count)
+{
+	const unsigned char* shades = (const unsigned char*)pixels;
+	std::size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		std::uint64_t eight;
+		std::memcpy(&eight, shades + i, sizeof(eight));
+		//The order of the shades in the word doesn't matter, every counter is summed in the end.
+		counts[0][eight & 0xff]++;
+		counts[1][(eight >> 8) & 0xff]++;
+		counts[2][(eight >> 16) & 0xff]++;
+		counts[3][(eight >> 24) & 0xff]++;
+		counts[0][(eight >> 32) & 0xff]++;
+		counts[1][(eight >> 40) & 0xff]++;
+		counts[2][(eight >> 48) & 0xff]++;
+		counts[3][eight >> 56]++;
+	}
+	for (; i < count; i++) counts[i & (lanes - 1)][shades[i]]++;
+}
+
+void Histogram::Accumulator::AddStrided(const GreyPixel* pixels, std::size_t count, std::size_t stride)
+{
+	if (stride <= 1)
+	{
+		Add(pixels, count);
+		return;
+	}
+	const unsigned char* shades = (const unsigned char*)pixels;
+	int lane = 0;
+	for (std::size_t i = 0; i < count; i += stride, lane = (lane + 1) & (lanes - 1)) counts[lane][shades[i]]++;
+}
+
+void Histogram::Accumulator::AddTo(unsigned int* frequency) const
+{
+	for (int i = 0; i < size; i++) frequency[i] += counts[0][i] + counts[1][i] + counts[2][i] + counts[3][i];
+}
+
+void Histogram::CountRow(const GreyPixel* pixels, std::size_t count, unsigned int* frequency)
+{
+	//Clearing and adding up the sub-histograms costs about as much as counting 1000 pixels directly.
+	if (count >= 4 * (std::size_t)size)
+	{
+		Accumulator accumulator;
+		accumulator.Add(pixels, count);
+		accumulator.AddTo(frequency);
+		return;
+	}
+	const unsigned char* shades = (const unsigned char*)pixels;
+	for (std::size_t i = 0; i < count; i++) frequency[shades[i]]++;
+}
+
+unsigned long long int Histogram::TonerSum(const unsigned int* frequency, int min, int max)
+{
+	unsigned long long int sum = 0;
+	for (int i = min; i <= max; i++)
+	{
+		sum += (unsigned long long int)frequency[i] * (GreyPixel::maxValue - i);
+	}
+	return sum;
+}
+
+unsigned long long int Histogram::PixelCount(const unsigned int* frequency, int min, int max)
+{
+	unsigned long long int sum = 0;
+	for (int i = min; i <= max; i++) sum += frequency[i];
+	return sum;
+}
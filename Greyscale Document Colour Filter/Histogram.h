@@ -0,0 +1,80 @@
+#pragma once
+
+#include "GreyPixel.h"
+#include <cstddef>
+
+/// <summary>
+/// Counting kernels for grey shade frequencies.
+/// A frequency array always has Histogram::size entries, the indices are the grey shades.
+/// </summary>
+class Histogram
+{
+public:
+	static const int size = GreyPixel::maxValue + 1;
+
+	/// <summary>
+	/// Counts grey shades into interleaved sub-histograms: consecutive pixels go to different sub-histograms,
+	/// so a run of the same shade (the background of a document) doesn't wait for the previous increment of the same counter.
+	/// Keep one per thread and add them to a frequency array at the end.
+	/// </summary>
+	class Accumulator
+	{
+	private:
+		static const int lanes = 4;
+		unsigned int counts[lanes][size];
+
+	public:
+		/// <summary>
+		/// Constructor. Every count starts at 0.
+		/// </summary>
+		Accumulator();
+
+		/// <summary>
+		/// Counts the grey shades of count consecutive pixels.
+		/// </summary>
+		/// <param name="pixels">The first pixel.</param>
+		/// <param name="count">The number of pixels.</param>
+		void Add(const GreyPixel* pixels, std::size_t count);
+		/// <summary>
+		/// Counts the grey shades of every stride-th pixel of count consecutive pixels, starting with the first one.
+		/// </summary>
+		/// <param name="pixels">The first pixel.</param>
+		/// <param name="count">The number of pixels (counted and skipped).</param>
+		/// <param name="stride">The distance of the counted pixels. 1 counts every pixel.</param>
+		void AddStrided(const GreyPixel* pixels, std::size_t count, std::size_t stride);
+		/// <summary>
+		/// Adds the counted frequencies to frequency.
+		/// </summary>
+		/// <param name="frequency">The array to add to.</param>
+		void AddTo(unsigned int* frequency) const;
+		/// <summary>
+		/// Sets every count to 0.
+		/// </summary>
+		void Clear();
+	};
+
+	/// <summary>
+	/// Adds the frequency of the grey shades of count consecutive pixels to frequency.
+	/// Long rows are counted with an Accumulator, short ones directly. To count many rows, keep an Accumulator instead.
+	/// </summary>
+	/// <param name="pixels">The first pixel.</param>
+	/// <param name="count">The number of pixels.</param>
+	/// <param name="frequency">The array to add to.</param>
+	static void CountRow(const GreyPixel* pixels, std::size_t count, unsigned int* frequency);
+
+	/// <summary>
+	/// The toner the pixels counted in frequency with a grey shade between min and max use: maxValue - shade units per pixel.
+	/// This is also the toner saved by setting those pixels to white.
+	/// </summary>
+	/// <param name="frequency">The frequency of the grey shades.</param>
+	/// <param name="min">The first grey shade to sum.</param>
+	/// <param name="max">The last grey shade to sum.</param>
+	static unsigned long long int TonerSum(const unsigned int* frequency, int min = 0, int max = GreyPixel::maxValue);
+	/// <summary>
+	/// The number of pixels counted in frequency with a grey shade between min and max.
+	/// </summary>
+	/// <param name="frequency">The frequency of the grey shades.</param>
+	/// <param name="min">The first grey shade to sum.</param>
+	/// <param name="max">The last grey shade to sum.</param>
+	static unsigned long long int PixelCount(const unsigned int* frequency, int min = 0, int max = GreyPixel::maxValue);
+};
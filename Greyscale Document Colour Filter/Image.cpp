@@ -1,7 +1,24 @@
 #include "Image.h"
+#include "GreyRemap.h"
+#include "MappedFile.h"
+#include "ZoneGrid.h"
+#include "ThreadPool.h"
+#include "Histogram.h"
+#include "PageArena.h"
+#include "BMPRunLength.h"
+#include "Netpbm.h"
+#include "SlidingHistogram.h"
+#include "TileHistograms.h"
+#include "RowEncoder.h"
+#include "WriteBehind.h"
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstring>
+#include <type_traits>
+#include <new>
+#include <algorithm>
+#include <atomic>
 
 //#define _USE_MATH_DEFINES
 #include <math.h>
@@ -9,68 +26,263 @@
 using std::ofstream;
 using std::ifstream;
 
-void Image::initPixels()
+bool Image::initPixels()
 {
-	colourpixels = new RGBPixel * [width];
-	for (unsigned long int i = 0; i < width; i++) colourpixels[i] = new RGBPixel[height];
+	stats.CountAllocation();
+	if (arena != nullptr) return colourpixels.Place(arena->Allocate(PixelPlane<RGBPixel>::AllocationSize(width, height)), width, height);     // nullptr if the arena couldn't grow.
+	return colourpixels.Allocate(width, height, hugePages);
 }
 
-void Image::initGreyscale()
+bool Image::initGreyscale()
 {
 	pixelsum = 0;
-	greypixels = new GreyPixel * [width];
-	for (unsigned long int i = 0; i < width; i++) greypixels[i] = new GreyPixel[height];
+	frequencyValid = false;
+	tonerSumValid = false;
+	zoneToner.clear();
+	stats.CountAllocation();
+	if (arena != nullptr) return greypixels.Place(arena->Allocate(PixelPlane<GreyPixel>::AllocationSize(width, height)), width, height);
+	return greypixels.Allocate(width, height, hugePages);
 }
 
-void Image::initFrequency(unsigned int* &frequency)
+void Image::CopySettings(const Image& Rhs)
 {
-	const int size = GreyPixel::maxValue + 1;
-	frequency = new unsigned int[size];
-	for (unsigned long int i = 0; i < size; i++)
+	hugePages = Rhs.hugePages;
+	greyFormula = Rhs.greyFormula;
+	width = Rhs.width;
+	height = Rhs.height;
+	filePath = Rhs.filePath;
+	readMode = Rhs.readMode;
+	format = Rhs.format;
+	pixelsum = Rhs.pixelsum;
+	tonerSum = Rhs.tonerSum;
+	tonerSumValid = Rhs.tonerSumValid;
+	std::copy(Rhs.frequency, Rhs.frequency + GreyPixel::maxValue + 1, frequency);
+	frequencyValid = Rhs.frequencyValid;
+	threadCount = Rhs.threadCount;
+	ownThreadPool = Rhs.ownThreadPool;
+	xPelsPerMeter = Rhs.xPelsPerMeter;
+	yPelsPerMeter = Rhs.yPelsPerMeter;
+	writeBehind = Rhs.writeBehind;
+	samplingStep = Rhs.samplingStep;
+	backgroundParameters = Rhs.backgroundParameters;
+}
+
+Image::Image(const Image& Rhs)
+{
+	CopySettings(Rhs);
+	if (!Rhs.colourpixels.IsEmpty() && colourpixels.Allocate(width, height, hugePages))
+	{
+		for (unsigned long int j = 0; j < height; j++) std::memcpy(colourpixels.Row(j), Rhs.colourpixels.Row(j), (std::size_t)width * sizeof(RGBPixel));
+	}
+	if (!Rhs.greypixels.IsEmpty() && greypixels.Allocate(width, height, hugePages))
+	{
+		for (unsigned long int j = 0; j < height; j++) std::memcpy(greypixels.Row(j), Rhs.greypixels.Row(j), (std::size_t)width * sizeof(GreyPixel));
+	}
+	if (colourpixels.IsEmpty() != Rhs.colourpixels.IsEmpty() || greypixels.IsEmpty() != Rhs.greypixels.IsEmpty())
 	{
-		frequency[i] = 0;
+		//Not enough memory for the copy: no half copied image.
+		colourpixels.Release();
+		greypixels.Release();
 	}
 }
 
+Image::Image(Image&& Rhs) noexcept
+{
+	*this = std::move(Rhs);
+}
+
+Image& Image::operator=(const Image& Rhs)
+{
+	if (this != &Rhs) *this = Image(Rhs);
+	return *this;
+}
+
+Image& Image::operator=(Image&& Rhs) noexcept
+{
+	if (this != &Rhs)
+	{
+		CopySettings(Rhs);
+		colourpixels = std::move(Rhs.colourpixels);
+		greypixels = std::move(Rhs.greypixels);
+		mappedFile = std::move(Rhs.mappedFile);
+		zoneToner = std::move(Rhs.zoneToner);
+		stats = Rhs.stats;
+		arena = Rhs.arena;
+		fileBuffer = Rhs.fileBuffer;
+		ownFileBuffer = std::move(Rhs.ownFileBuffer);
+		bufferSize = Rhs.bufferSize;
+		bufferCapacity = Rhs.bufferCapacity;
+		scratch = Rhs.scratch;
+		ownScratch = std::move(Rhs.ownScratch);
+		scratchSize = Rhs.scratchSize;
+
+		Rhs.fileBuffer = nullptr;
+		Rhs.scratch = nullptr;
+		Rhs.scratchSize = 0;
+		Rhs.bufferSize = 0;
+		Rhs.bufferCapacity = 0;
+		Rhs.frequencyValid = false;
+		Rhs.pixelsum = 0;
+		Rhs.tonerSumValid = false;
+		Rhs.width = Rhs.height = 0;
+	}
+	return *this;
+}
+
+char* Image::AllocateScratch(std::size_t size)
+{
+	if (scratch != nullptr && size <= scratchSize) return scratch;
+	stats.CountAllocation();
+	if (arena != nullptr) scratch = (char*)arena->Allocate(size);
+	else
+	{
+		ownScratch.reset(new (std::nothrow) char[size]);
+		scratch = ownScratch.get();
+	}
+	scratchSize = scratch != nullptr ? size : 0;
+	return scratch;
+}
+
+char* Image::AllocateFileBuffer(std::uint64_t size) const
+{
+	stats.CountAllocation();
+	if (arena != nullptr) return (char*)arena->Allocate((std::size_t)size);
+	ownFileBuffer.reset(new (std::nothrow) char[(std::size_t)size]);
+	return ownFileBuffer.get();
+}
+
+void Image::Release()
+{
+	colourpixels.Release();
+	greypixels.Release();
+	mappedFile.Close();
+	ownFileBuffer.reset();
+	fileBuffer = nullptr;
+	bufferSize = 0;
+	bufferCapacity = 0;
+	ownScratch.reset();
+	scratch = nullptr;
+	scratchSize = 0;
+	frequencyValid = false;
+	pixelsum = 0;
+	tonerSumValid = false;
+	zoneToner.clear();
+	width = height = 0;
+}
+
+void Image::SetPixelsumFromFrequency()
+{
+	//Every pixel uses (maxValue - luminance) units of toner, white uses none.
+	pixelsum = Histogram::TonerSum(frequency);
+	tonerSum = pixelsum;
+	tonerSumValid = true;
+}
+
 void Image::ValidateDimensions(unsigned long int& minWidth, unsigned long int& minHeight, unsigned long int& maxWidth, unsigned long int& maxHeight)
 {
 	if (maxWidth == 0 || maxWidth <= minWidth || maxWidth > GetWidth()) maxWidth = GetWidth();
 	if (maxHeight == 0 || maxHeight <= minHeight || maxHeight > GetHeight()) maxHeight = GetHeight();
 }
 
-RGBPixel** Image::GetColourPixels() const
+PixelPlane<RGBPixel>& Image::GetColourPixels()
+{
+	return colourpixels;
+}
+
+const PixelPlane<RGBPixel>& Image::GetColourPixels() const
 {
 	return colourpixels;
 }
 
-GreyPixel** Image::GetGreyPixels() const
+PixelPlane<GreyPixel>& Image::GetGreyPixels()
 {
+	frequencyValid = false;     // The caller may modify the pixels.
+	tonerSumValid = false;
 	return greypixels;
 }
 
-void Image::RGBtoGreyscale()
+const PixelPlane<GreyPixel>& Image::GetGreyPixels() const
 {
-	initGreyscale();
-	for (unsigned long int i = 0; i < width; i++)
+	return greypixels;
+}
+
+bool Image::RGBtoGreyscale()
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::CONVERSION);
+	if (colourpixels.IsEmpty()) return false;
+	if (!initGreyscale())
 	{
-		for (unsigned long int j = 0; j < height; j++)
-		{
-			greypixels[i][j] = colourpixels[i][j].toGrey();
-			pixelsum += -1 * (long long)greypixels[i][j].GetLuminance() + GreyPixel::maxValue;
-		}
+		if (verbose) std::cout << "Not enough memory to convert " << filePath << " to greyscale" << std::endl;
+		return false;
 	}
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::CONVERSION];
+	counters.pixels += (unsigned long long int)width * height;
+	counters.bytesRead += (unsigned long long int)width * height * sizeof(RGBPixel);
+	counters.bytesWritten += (unsigned long long int)width * height * sizeof(GreyPixel);
+	std::fill_n(frequency, GreyPixel::maxValue + 1, 0);
+	Histogram::Accumulator accumulator;
+	for (unsigned long int j = 0; j < height; j++)
+	{
+		GreyPixel* greyRow = greypixels.Row(j);
+		GreyConversion::ConvertRow(colourpixels.Row(j), greyRow, width, greyFormula);
+		accumulator.Add(greyRow, width);     // The row is still in the cache.
+	}
+	accumulator.AddTo(frequency);
+	frequencyValid = true;
+	SetPixelsumFromFrequency();
+	return true;
 }
 
-double Image::TonerUsage()
+std::atomic<bool> Image::verbose(true);
+
+unsigned long long int Image::CurrentTonerSum() const
 {
+	if (tonerSumValid) return tonerSum;
 	unsigned long long int sum = 0;
-	for (unsigned long int i = 0; i < GetWidth(); i++)
+	for (unsigned long int j = 0; j < GetHeight(); j++)
 	{
-		for (unsigned long int j = 0; j < GetHeight(); j++)
+		const GreyPixel* greyRow = greypixels.Row(j);
+		for (unsigned long int i = 0; i < GetWidth(); i++)
 		{
-			sum += -1 * (long long)greypixels[i][j].GetLuminance() + GreyPixel::maxValue;
+			sum += -1 * (long long)greyRow[i].GetLuminance() + GreyPixel::maxValue;
 		}
 	}
+	tonerSum = sum;
+	tonerSumValid = !greypixels.IsEmpty();
+	return sum;
+}
+
+double Image::OriginalTonerUsage() const
+{
+	return (double)pixelsum / GreyPixel::maxValue;
+}
+
+double Image::CurrentTonerUsage() const
+{
+	return (double)CurrentTonerSum() / GreyPixel::maxValue;
+}
+
+TonerReport Image::GetTonerReport() const
+{
+	TonerReport report;
+	report.original = OriginalTonerUsage();
+	report.current = CurrentTonerUsage();
+	report.zones = zoneToner;
+	return report;
+}
+
+void Image::WriteStatsJSON(std::ostream& stream) const
+{
+	stream << "{\"file\":";
+	ImageStats::WriteJSONString(stream, filePath);
+	stream << ",\"width\":" << width << ",\"height\":" << height << ",\"stages\":";
+	stats.WriteJSON(stream);
+	stream << "}\n";
+}
+
+double Image::TonerUsage()
+{
+	unsigned long long int sum = CurrentTonerSum();
 	unsigned long long int difference = pixelsum - sum;
 	double saved = double(difference) / GreyPixel::maxValue;
 
@@ -82,60 +294,64 @@ double Image::TonerUsage()
 	return saved;
 }
 
-Image Image::Crop(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
+bool Image::IsOwnView(const ImageView& region) const
 {
-	if (maxWidth > width)
-	{
-		//TODO: error handling
-		return NULL;
-	}
-	if (maxHeight > height)
-	{
-		//TODO: error handling
-		return NULL;
-	}
-
-	unsigned long int cropWidth = maxWidth - minWidth;
-	unsigned long int cropHeight = maxHeight - minHeight;
-
-	Image Crop = Image(cropWidth, cropHeight);
-	Crop.format = this->format;
-	Crop.initPixels();
-	RGBPixel** pixelArray = Crop.GetColourPixels();
-	for (unsigned long int i = 0; i < Crop.GetWidth(); i++)
-	{
-		for (unsigned long int j = 0; j < Crop.GetHeight(); j++)
-		{
-			pixelArray[i][j] = colourpixels[minWidth + i][minHeight + j];
-		}
-	}
+	if (region.IsEmpty()) return false;
+	if (region.GetImage() == this) return true;
+	if (verbose) std::cout << "The view is of another image than " << filePath << ", it is ignored" << std::endl;
+	return false;
+}
 
-	return Crop;
+ImageView Image::Crop(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
+{
+	if (maxWidth > width || maxHeight > height) return ImageView();
+	return ImageView(*this, minWidth, minHeight, maxWidth, maxHeight);
 }
 
-unsigned int* Image::GetGreyScaleFrequency(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+Image::Frequency Image::GetGreyScaleFrequency(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
 {
-	if (greypixels == nullptr) RGBtoGreyscale();
-	unsigned int* frequency = nullptr;
-	initFrequency(frequency);
+	ImageStats::Timer timer(stats, ImageStats::STAGE::HISTOGRAM);
+	Frequency frequency = {};
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return frequency;     // No pixels: every count is 0.
 	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
-	for (unsigned long int i = minWidth; i < maxWidth; i++)
+	if (frequencyValid && minWidth == 0 && minHeight == 0 && maxWidth == GetWidth() && maxHeight == GetHeight())
 	{
-		for (unsigned long int j = minHeight; j < maxHeight; j++)
-		{
-			unsigned char idx = greypixels[i][j].GetLuminance();
-			frequency[idx]++;
-		}
+		std::copy(this->frequency, this->frequency + GreyPixel::maxValue + 1, frequency.begin());
+		return frequency;
 	}
+	CountRegion(frequency.data(), minWidth, minHeight, maxWidth, maxHeight);
+	stats[ImageStats::STAGE::HISTOGRAM].pixels += (unsigned long long int)(maxWidth - minWidth) * (maxHeight - minHeight);
 	return frequency;
 }
 
-void Image::FindAndDeleteBackground(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+Image::Frequency Image::GetGreyScaleFrequency(const ImageView& region)
 {
-	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
-	
-	unsigned int* frequency = GetGreyScaleFrequency(minWidth, minHeight, maxWidth, maxHeight);
+	if (IsOwnView(region)) return GetGreyScaleFrequency(region.GetMinWidth(), region.GetMinHeight(), region.GetMaxWidth(), region.GetMaxHeight());
+	return Frequency();
+}
+
+void Image::CountRegion(unsigned int* frequency, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
+{
+	//Every band of rows is counted into its own sub-histograms, they are only added up at the end.
+	//A band is at least about a megapixel, below that starting the threads costs more than the counting.
+	const unsigned long long int pixels = (unsigned long long int)(maxWidth - minWidth) * (maxHeight - minHeight);
+	ThreadPool* pool = GetThreadPool();
+	const unsigned long long int maxBands = pool != nullptr ? pool->GetThreadCount() : 1;
+	const unsigned long int bands = (unsigned long int)std::max(1ull, std::min(maxBands, pixels >> 20));
+	std::vector<Histogram::Accumulator> accumulators(bands);
+	auto band = [&](std::size_t b)
+	{
+		const unsigned long int first = minHeight + (unsigned long int)((unsigned long long int)(maxHeight - minHeight) * b / bands);
+		const unsigned long int last = minHeight + (unsigned long int)((unsigned long long int)(maxHeight - minHeight) * (b + 1) / bands);
+		for (unsigned long int j = first; j < last; j++) accumulators[b].Add(greypixels.Row(j) + minWidth, maxWidth - minWidth);
+	};
+	if (bands > 1) pool->ParallelFor(bands, band, 1);
+	else band(0);
+	for (const Histogram::Accumulator& accumulator : accumulators) accumulator.AddTo(frequency);
+}
 
+GreyPixel Image::FindBackgroundStart(const unsigned int* frequency, const BackgroundParameters& parameters, unsigned int* errorBound)
+{
 	//Last local maximum:
 	/*unsigned int maxIdx = GreyPixel::White().GetLuminance() - 1;
 	while (maxIdx > 1 && frequency[maxIdx] <= frequency[maxIdx - 1])
@@ -143,21 +359,34 @@ void Image::FindAndDeleteBackground(unsigned long int minWidth, unsigned long in
 		maxIdx--;
 	}*/
 
-	//"Global" maximum between 150 and 250:
-	unsigned int maxIdx = 150;
-	for (int i = maxIdx + 1; i < 250; i++)
+	//"Global" maximum between peakMin and peakMax (150 and 250 by default):
+	const unsigned int peakMax = std::min<unsigned int>(parameters.peakMax, Histogram::size);
+	unsigned int maxIdx = std::min(parameters.peakMin, peakMax > 0 ? peakMax - 1 : 0);
+	for (unsigned int i = maxIdx + 1; i < peakMax; i++)
 	{
 		if (frequency[i] > frequency[maxIdx]) maxIdx = i;
 	}
 
 	//Calculating the start of the interval that will be set to white:
 	//start = percent% of maxIdx
-	const double percent = 0.15;
-	//const double percent = 0.015;
-	//About 1.5% is the best result we got for peldaDok.bmp
+	const double percent = parameters.percent;
 	unsigned int startIdx = maxIdx;
 	while (frequency[startIdx] > (frequency[maxIdx] * percent) && startIdx > 0) startIdx--;
-	const GreyPixel start = GreyPixel(startIdx);
+
+	if (errorBound != nullptr)
+	{
+		//The walk could stop as early as the first shade that is possibly under the limit, and as late as the first one that is surely under it.
+		auto noise = [](unsigned int count) { return 2 * sqrt((double)count); };
+		const double peak = frequency[maxIdx];
+		const double highLimit = (peak + noise(frequency[maxIdx])) * percent;
+		const double lowLimit = (peak - noise(frequency[maxIdx])) * percent;
+		unsigned int earliest = maxIdx;
+		while (earliest > 0 && frequency[earliest] - noise(frequency[earliest]) > highLimit) earliest--;
+		unsigned int latest = maxIdx;
+		while (latest > 0 && frequency[latest] + noise(frequency[latest]) > lowLimit) latest--;
+		*errorBound = std::max(earliest - startIdx, startIdx - latest);
+	}
+	return GreyPixel(startIdx);
 
 	//Symmetrical: max is the center point of the interval
 	//const GreyPixel start = GreyPixel(maxIdx - (GreyPixel::White().GetLuminance() - maxIdx));
@@ -165,128 +394,344 @@ void Image::FindAndDeleteBackground(unsigned long int minWidth, unsigned long in
 	//Asymmetrical: start = maxIdx/divisor
 	/*const double divisor = 2;
 	const GreyPixel start = GreyPixel((maxIdx - (GreyPixel::White().GetLuminance() - maxIdx/divisor)));*/
-
-	CutOutGreys(start, GreyPixel::White(), minWidth, minHeight, maxWidth, maxHeight);
 }
 
-void Image::FindAndDeleteBackgroundInZones(int zoneSize, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+void Image::FindAndDeleteBackground(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
 {
+	ImageStats::Timer timer(stats, ImageStats::STAGE::BACKGROUND);
 	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
 
-	unsigned long int cols = (maxWidth - minWidth) / zoneSize;
-	unsigned long int rows = (maxHeight - minHeight) / zoneSize;
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return;
+	frequencyValid = false;
 
-	double zoneWidth = double(maxWidth - minWidth) / cols;
-	double zoneHeight = double(maxHeight - minHeight) / rows;
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::BACKGROUND];
+	counters.pixels += (unsigned long long int)(maxWidth - minWidth) * (maxHeight - minHeight);
+	counters.zones++;
 
-	for (unsigned long int i = 0; i < cols; i++)
+	unsigned int frequency[Histogram::size] = {};
+	if (samplingStep <= 1)
 	{
-		unsigned long int startWidth = floor((double)i * zoneWidth);
-		unsigned long int stopWidth = floor(double(i + 1) * zoneWidth);
-		for (unsigned long int j = 0; j < rows; j++)
-		{
-			unsigned long int startHeight = floor((double)j * zoneHeight);
-			unsigned long int stopHeight = floor(double(j + 1) * zoneHeight);
-
-			FindAndDeleteBackground(startWidth, startHeight, stopWidth, stopHeight);
-		}
+		CountRegion(frequency, minWidth, minHeight, maxWidth, maxHeight);
+		const unsigned long long int saved = DeleteBackgroundInRegion(frequency, minWidth, minHeight, maxWidth, maxHeight);
+		if (tonerSumValid) tonerSum -= saved;
+		return;
 	}
+
+	//The start of the background is estimated from a sample, the toner saved is summed from the pixels.
+	Histogram::Accumulator accumulator;
+	for (unsigned long int j = minHeight; j < maxHeight; j += samplingStep) accumulator.AddStrided(greypixels.Row(j) + minWidth, maxWidth - minWidth, samplingStep);
+	accumulator.AddTo(frequency);
+	unsigned int error = 0;
+	const unsigned char start = FindBackgroundStart(frequency, backgroundParameters, &error).GetLuminance();
+	counters.startError = std::max<unsigned long long int>(counters.startError, error);
+	unsigned long long int saved = 0;
+	for (unsigned long int j = minHeight; j < maxHeight; j++) saved += GreyRemap::WhitenFrom(greypixels.Row(j) + minWidth, maxWidth - minWidth, start);
+	if (tonerSumValid) tonerSum -= saved;
 }
 
-void Image::FindAndDeleteBackgroundInZonesWithZoneAmount(int zones, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+void Image::FindAndDeleteBackgroundWithFrequency(const unsigned int* frequency, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
 {
+	ImageStats::Timer timer(stats, ImageStats::STAGE::BACKGROUND);
 	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
 
-	unsigned long long int imageArea = (long long)(maxWidth - minWidth) * (long long)(maxHeight - minHeight);
-	double zoneArea = (double)imageArea / zones;
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return;
+	frequencyValid = false;
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::BACKGROUND];
+	counters.pixels += (unsigned long long int)(maxWidth - minWidth) * (maxHeight - minHeight);
+	counters.zones++;
 
-	double zoneSize = sqrt(zoneArea);
+	//The toner saved is summed from the caller's frequency, which doesn't have to match the pixels: the sum is counted again when it is asked for.
+	DeleteBackgroundInRegion(frequency, minWidth, minHeight, maxWidth, maxHeight);
+	tonerSumValid = false;
+}
 
-	unsigned long int cols = (maxWidth - minWidth) / zoneSize;
-	unsigned long int rows = (maxHeight - minHeight) / zoneSize;
+unsigned long long int Image::DeleteBackgroundInRegion(const unsigned int* frequency, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	//Every pixel of the interval becomes white, so the toner they used is exactly what is saved.
+	const unsigned char start = FindBackgroundStart(frequency, backgroundParameters).GetLuminance();
+	CutOutInterval(start, GreyPixel::maxValue, minWidth, minHeight, maxWidth, maxHeight);
+	return Histogram::TonerSum(frequency, start);
+}
 
-	double zoneWidth = double(maxWidth - minWidth) / cols;
-	double zoneHeight = double(maxHeight - minHeight) / rows;
+void Image::FindAndDeleteBackgroundInZones(int zoneSize, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
+	FindAndDeleteBackgroundInGrid(ZoneGrid::FromZoneSize(zoneSize, minWidth, minHeight, maxWidth, maxHeight));
+}
 
-	for (unsigned long int i = 0; i < cols; i++)
+void Image::FindAndDeleteBackgroundInZonesWithZoneAmount(int zones, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
+	FindAndDeleteBackgroundInGrid(ZoneGrid::FromZoneAmount(zones, minWidth, minHeight, maxWidth, maxHeight));
+}
+
+void Image::FindAndDeleteBackgroundInGrid(const ZoneGrid& grid)
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::BACKGROUND);
+	if (grid.GetZoneCount() == 0) return;
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return;
+	frequencyValid = false;
+
+	//One task per thread: every task takes the next row of zones until there are none left. Its rows are counted, then walked once more, deleting the background of each zone they cross.
+	//Only the frequencies of one row of zones per thread exist at a time, and the band of rows is still in the cache for the second walk, however small the zones are.
+	//The rows of zones are disjoint, so they can be processed in any order, on any thread.
+	//With sampling the frequencies are only estimates, the toner is summed from the pixels during the second walk instead.
+	const unsigned long int cols = grid.GetColumns();
+	const bool sampled = samplingStep > 1;
+	ThreadPool* pool = GetThreadPool();
+	const std::size_t threads = pool != nullptr ? std::min<std::size_t>(pool->GetThreadCount(), grid.GetRows()) : 1;
+
+	//Every thread works in its own slot of one scratch block: the accumulators and frequencies of a row of zones, and per zone the start, the original and the saved toner.
+	auto aligned = [](std::size_t bytes) { return (bytes + PixelMemory::alignment - 1) / PixelMemory::alignment * PixelMemory::alignment; };
+	const unsigned long int accumulatorCount = TileHistograms::AccumulatorCount(grid, samplingStep);
+	const std::size_t accumulatorBytes = aligned(accumulatorCount * sizeof(Histogram::Accumulator));
+	const std::size_t countBytes = aligned((std::size_t)cols * Histogram::size * sizeof(unsigned int));
+	const std::size_t tonerBytes = aligned((std::size_t)cols * sizeof(unsigned long long int));
+	const std::size_t slotBytes = accumulatorBytes + countBytes + 2 * tonerBytes + aligned(cols);
+	char* scratch = AllocateScratch(threads * slotBytes);
+	if (scratch == nullptr)
 	{
-		unsigned long int startWidth = floor((double)i * zoneWidth);
-		unsigned long int stopWidth = floor(double(i + 1) * zoneWidth);
-		for (unsigned long int j = 0; j < rows; j++)
+		if (verbose) std::cout << "Not enough memory to remove the background of " << filePath << std::endl;
+		return;
+	}
+	if (zoneToner.capacity() < grid.GetZoneCount()) stats.CountAllocation();
+	zoneToner.resize(grid.GetZoneCount());
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::BACKGROUND];
+	counters.pixels += (unsigned long long int)(grid.ColumnStart(grid.GetColumns()) - grid.ColumnStart(0)) * (grid.RowStart(grid.GetRows()) - grid.RowStart(0));
+	counters.zones += grid.GetZoneCount();
+
+	std::atomic<unsigned long long int> saved(0);
+	std::atomic<unsigned int> maxError(0);
+	std::atomic<std::size_t> next(0);
+	auto worker = [this, &grid, cols, sampled, scratch, slotBytes, accumulatorCount, accumulatorBytes, countBytes, tonerBytes, &next, &saved, &maxError](std::size_t t)
+	{
+		char* slot = scratch + t * slotBytes;
+		Histogram::Accumulator* accumulators = accumulatorCount > 0 ? (Histogram::Accumulator*)slot : nullptr;
+		unsigned int* counts = (unsigned int*)(slot + accumulatorBytes);
+		unsigned long long int* original = (unsigned long long int*)(slot + accumulatorBytes + countBytes);
+		unsigned long long int* zoneSaved = (unsigned long long int*)(slot + accumulatorBytes + countBytes + tonerBytes);
+		unsigned char* starts = (unsigned char*)(slot + accumulatorBytes + countBytes + 2 * tonerBytes);
+		unsigned long long int threadSaved = 0;
+		unsigned int threadError = 0;
+		for (std::size_t row = next++; row < grid.GetRows(); row = next++)
 		{
-			unsigned long int startHeight = floor((double)j * zoneHeight);
-			unsigned long int stopHeight = floor(double(j + 1) * zoneHeight);
+			const unsigned long int j = (unsigned long int)row;
+			std::fill_n(counts, (std::size_t)cols * Histogram::size, 0);
+			TileHistograms::CountZoneRow(greypixels, grid, j, counts, accumulators, samplingStep);
+
+			for (unsigned long int i = 0; i < cols; i++)
+			{
+				const unsigned int* frequency = counts + (std::size_t)i * Histogram::size;
+				unsigned int error = 0;
+				starts[i] = FindBackgroundStart(frequency, backgroundParameters, sampled ? &error : nullptr).GetLuminance();
+				threadError = std::max(threadError, error);
+				original[i] = zoneSaved[i] = 0;
+				if (sampled) continue;
+				//Every pixel from the start of the background up becomes white, so the toner they used is exactly what is saved.
+				original[i] = Histogram::TonerSum(frequency);
+				zoneSaved[i] = Histogram::TonerSum(frequency, starts[i]);
+			}
+
+			for (unsigned long int y = grid.RowStart(j); y < grid.RowStart(j + 1); y++)
+			{
+				GreyPixel* pixels = greypixels.Row(y);
+				for (unsigned long int i = 0; i < cols; i++)
+				{
+					GreyPixel* segment = pixels + grid.ColumnStart(i);
+					const unsigned long int count = grid.ColumnStart(i + 1) - grid.ColumnStart(i);
+					if (sampled)
+					{
+						zoneSaved[i] += GreyRemap::WhitenFrom(segment, count, starts[i], &original[i]);
+					}
+					else if (starts[i] != GreyPixel::maxValue) GreyRemap::ApplyInterval(segment, count, starts[i], GreyPixel::maxValue - 1, GreyPixel::maxValue);     // Only white: nothing to delete.
+				}
+			}
 
-			FindAndDeleteBackground(startWidth, startHeight, stopWidth, stopHeight);
+			for (unsigned long int i = 0; i < cols; i++)
+			{
+				TonerReport::Zone& toner = zoneToner[(std::size_t)j * cols + i];
+				toner.minWidth = grid.ColumnStart(i);
+				toner.minHeight = grid.RowStart(j);
+				toner.maxWidth = grid.ColumnStart(i + 1);
+				toner.maxHeight = grid.RowStart(j + 1);
+				toner.original = (double)original[i] / GreyPixel::maxValue;
+				toner.saved = (double)zoneSaved[i] / GreyPixel::maxValue;
+				threadSaved += zoneSaved[i];
+			}
 		}
-	}
+		saved += threadSaved;
+		unsigned int seen = maxError;
+		while (threadError > seen && !maxError.compare_exchange_weak(seen, threadError)) {}
+	};
+	if (pool != nullptr && threads > 1) pool->ParallelFor(threads, worker, 1);
+	else worker(0);
+	if (tonerSumValid) tonerSum -= saved;     // No rescan needed, the zones already know what they saved.
+	counters.startError = std::max<unsigned long long int>(counters.startError, maxError);
 }
 
-void Image::CutOutColour(const RGBPixel Colour, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+void Image::FindAndDeleteBackgroundSliding(int windowSize, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
 {
+	ImageStats::Timer timer(stats, ImageStats::STAGE::BACKGROUND);
 	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
+	if (windowSize < 1 || windowSize > 0xffff || maxWidth <= minWidth || maxHeight <= minHeight) return;
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return;
+	frequencyValid = false;
+	zoneToner.clear();
+
+	const unsigned long int width = maxWidth - minWidth;
+	const unsigned long int height = maxHeight - minHeight;
+	const unsigned long int radius = (unsigned long int)windowSize / 2;
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::BACKGROUND];
+	counters.pixels += (unsigned long long int)width * height;
+
+	//Every band starts by filling its column histograms with the rows of its first window, so the bands are kept much taller than the window.
+	ThreadPool* pool = GetThreadPool();
+	const unsigned long int maxBands = pool != nullptr ? pool->GetThreadCount() : 1;
+	const unsigned long int bands = std::max(1ul, std::min(maxBands, height / (4 * (2 * radius + 1))));
+
+	//The windows overlap, so the thresholds are computed from the original shades while the pixels are deleted. A band only needs the originals of
+	//the rows its window still covers: its last radius + 1 rows already deleted (a ring), and the radius rows of each neighbouring band next to it,
+	//which are copied before any band starts. Every band works in its own slot of one scratch block, with the column counts of its histogram.
+	auto aligned = [](std::size_t bytes) { return (bytes + PixelMemory::alignment - 1) / PixelMemory::alignment * PixelMemory::alignment; };
+	const std::size_t rowBytes = (std::size_t)width * sizeof(GreyPixel);
+	const unsigned long int ringRows = std::min(radius + 1, height / bands + 1);
+	const unsigned long int marginRows = bands > 1 ? radius : 0;
+	const std::size_t histogramBytes = aligned(SlidingHistogram::MemorySize(width));
+	const std::size_t slotBytes = histogramBytes + aligned((ringRows + 2 * marginRows) * rowBytes);
+	char* scratch = AllocateScratch(bands * slotBytes);
+	if (scratch == nullptr)
+	{
+		if (verbose) std::cout << "Not enough memory to remove the background of " << filePath << std::endl;
+		return;
+	}
+	auto bandFirst = [minHeight, height, bands](std::size_t b) { return minHeight + (unsigned long int)(height * b / bands); };
+	auto topMargin = [&](std::size_t b) { return (GreyPixel*)(scratch + b * slotBytes + histogramBytes + ringRows * rowBytes); };
+	auto bottomMargin = [&](std::size_t b) { return topMargin(b) + (std::size_t)marginRows * width; };
+	for (std::size_t b = 0; b < bands; b++)
+	{
+		const unsigned long int first = bandFirst(b);
+		const unsigned long int last = bandFirst(b + 1);
+		if (b > 0) for (unsigned long int y = first - marginRows; y < first; y++) std::memcpy(topMargin(b) + (std::size_t)(y - first + marginRows) * width, greypixels.Row(y) + minWidth, rowBytes);
+		if (b + 1 < bands) for (unsigned long int y = last; y < last + marginRows; y++) std::memcpy(bottomMargin(b) + (std::size_t)(y - last) * width, greypixels.Row(y) + minWidth, rowBytes);
+	}
 
-	for (unsigned int i = minWidth; i < maxWidth; i++)
+	std::atomic<unsigned long long int> saved(0);
+	auto band = [&](std::size_t b)
 	{
-		for (unsigned int j = minHeight; j < maxHeight; j++)
+		const unsigned long int first = bandFirst(b);
+		const unsigned long int last = bandFirst(b + 1);
+		SlidingHistogram histogram(width, radius, scratch + b * slotBytes);
+		GreyPixel* ring = (GreyPixel*)(scratch + b * slotBytes + histogramBytes);
+		GreyPixel* top = topMargin(b);
+		GreyPixel* bottom = bottomMargin(b);
+		unsigned long int current = first;
+		auto originalRow = [&](unsigned long int y) -> const GreyPixel*
 		{
-			if (colourpixels[i][j] == Colour) colourpixels[i][j] = RGBPixel::White();
+			if (y < first) return top + (std::size_t)(y - first + marginRows) * width;
+			if (y >= last) return bottom + (std::size_t)(y - last) * width;
+			if (y < current) return ring + (std::size_t)((y - first) % ringRows) * width;
+			return greypixels.Row(y) + minWidth;
+		};
+		for (unsigned long int y = first > minHeight + radius ? first - radius : minHeight; y < std::min(maxHeight, first + radius + 1); y++) histogram.AddRow(originalRow(y));
+
+		unsigned long long int bandSaved = 0;
+		for (unsigned long int y = first; y < last; y++)
+		{
+			if (y > first)
+			{
+				if (y + radius < maxHeight) histogram.AddRow(originalRow(y + radius));
+				if (y > minHeight + radius) histogram.RemoveRow(originalRow(y - radius - 1));
+			}
+			//The row leaving the window was the last one in this slot of the ring.
+			GreyPixel* destination = greypixels.Row(y) + minWidth;
+			GreyPixel* source = ring + (std::size_t)((y - first) % ringRows) * width;
+			std::memcpy(source, destination, rowBytes);
+			current = y + 1;
+			histogram.StartRow();
+			for (unsigned long int x = 0; x < width; x++)
+			{
+				const unsigned char shade = source[x].GetLuminance();
+				if (shade == GreyPixel::maxValue) continue;     // Already white, the threshold isn't needed.
+				histogram.MoveTo(x);
+				if (histogram.IsBackground(shade, backgroundParameters))
+				{
+					destination[x] = GreyPixel::White();
+					bandSaved += GreyPixel::maxValue - shade;
+				}
+			}
 		}
-	}
+		saved += bandSaved;
+	};
+	if (pool != nullptr && bands > 1) pool->ParallelFor(bands, band, 1);
+	else for (std::size_t b = 0; b < bands; b++) band(b);
+	if (tonerSumValid) tonerSum -= saved;
 }
 
-Image Image::CutOutGrey(const GreyPixel Grey, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
+void Image::SetThreadCount(unsigned int threads)
+{
+	threadCount = threads;
+	ownThreadPool.reset();
+	if (threads > 1) ownThreadPool = std::make_shared<ThreadPool>(threads);
+}
+
+ThreadPool* Image::GetThreadPool() const
 {
-	Image Cut = Image(width,height);
-	Cut.initPixels();
-	for (unsigned long int i = 0; i < Cut.GetWidth(); i++)
+	if (threadCount == 1) return nullptr;
+	if (threadCount == 0) return &ThreadPool::Shared();
+	return ownThreadPool.get();
+}
+
+void Image::CutOutColour(const RGBPixel Colour, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::CUT);
+	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
+	stats[ImageStats::STAGE::CUT].pixels += (unsigned long long int)(maxWidth - minWidth) * (maxHeight - minHeight);
+
+	for (unsigned long int j = minHeight; j < maxHeight; j++)
 	{
-		for (unsigned long int j = 0; j < Cut.GetHeight(); j++)
+		RGBPixel* colourRow = colourpixels.Row(j);
+		for (unsigned long int i = minWidth; i < maxWidth; i++)
 		{
-			Cut.GetColourPixels()[i][j] = colourpixels[i][j];
+			if (colourRow[i] == Colour) colourRow[i] = RGBPixel::White();
 		}
 	}
-	Cut.RGBtoGreyscale();
+}
+
+Image Image::CutOutGrey(const GreyPixel Grey, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
+{
+	Image Cut(*this);
 	Cut.CutOutGrey(Grey, minWidth, minHeight, maxWidth, maxHeight);
 	return Cut;
 }
 
 void Image::CutOutGrey(const GreyPixel Grey, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
 {
+	ImageStats::Timer timer(stats, ImageStats::STAGE::CUT);
 	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
+	stats[ImageStats::STAGE::CUT].pixels += (unsigned long long int)(maxWidth - minWidth) * (maxHeight - minHeight);
 
-	if (greypixels == nullptr) RGBtoGreyscale();
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return;
 
 	if (Grey.GetLuminance() != GreyPixel::maxValue)
 	{
-		for (unsigned int i = minWidth; i < maxWidth; i++)
-		{
-			for (unsigned int j = minHeight; j < maxHeight; j++)
-			{
-				if (greypixels[i][j] == Grey) greypixels[i][j] = GreyPixel::White();
-			}
-		}
+		frequencyValid = false;
+		tonerSumValid = false;
+		GreyRemap remap;
+		remap.Map(Grey, GreyPixel::White());
+		remap.Apply(greypixels, minWidth, minHeight, maxWidth, maxHeight);
 	}
 }
 
 Image Image::CutOutGreys(const GreyPixel minGrey, const GreyPixel maxGrey, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
 {
-	Image Cut = Image(width, height);
-	Cut.initPixels();
-	for (unsigned long int i = 0; i < Cut.GetWidth(); i++)
-	{
-		for (unsigned long int j = 0; j < Cut.GetHeight(); j++)
-		{
-			Cut.GetColourPixels()[i][j] = colourpixels[i][j];
-		}
-	}
-	Cut.RGBtoGreyscale();
+	Image Cut(*this);
 	Cut.CutOutGreys(minGrey, maxGrey, minWidth, minHeight, maxWidth, maxHeight);
 	return Cut;
 }
 
 void Image::CutOutGreys(const GreyPixel minGrey, const GreyPixel maxGrey, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
 {
+	ImageStats::Timer timer(stats, ImageStats::STAGE::CUT);
 	unsigned char min = minGrey.GetLuminance();
 	unsigned char max = maxGrey.GetLuminance();
 	if (max < min)
@@ -295,79 +740,363 @@ void Image::CutOutGreys(const GreyPixel minGrey, const GreyPixel maxGrey, unsign
 		min= max;
 		max= tmp;
 	}
+
+	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
+	stats[ImageStats::STAGE::CUT].pixels += (unsigned long long int)(maxWidth - minWidth) * (maxHeight - minHeight);
+
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return;
+
+	frequencyValid = false;
+	tonerSumValid = false;
+	CutOutInterval(min, max, minWidth, minHeight, maxWidth, maxHeight);
+}
+
+void Image::CutOutInterval(unsigned char min, unsigned char max, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
 	if (max == GreyPixel::maxValue) max = GreyPixel::maxValue - 1;
-	for (unsigned char i = min; i <= max; i++)
-	{
-		CutOutGrey(GreyPixel(i), minWidth, minHeight, maxWidth, maxHeight);
-	}
+	if (max < min) return;
+
+	//Every shade of the interval is replaced in a single pass over the region.
+	GreyRemap remap;
+	remap.MapInterval(GreyPixel(min), GreyPixel(max), GreyPixel::White());
+	remap.Apply(greypixels, minWidth, minHeight, maxWidth, maxHeight);
 }
 
 bool Image::Read()
 {
 	std::string fileext = filePath.substr(filePath.find_last_of('.') + 1);
 	if (fileext == "bmp") return ReadBMP24();
-	std::cout << "Could not get file extension or not supported." << std::endl;
+	if (fileext == "pgm" || fileext == "ppm" || fileext == "pbm" || fileext == "pnm") return ReadNetpbm();
+	if (verbose) std::cout << "Could not get file extension or not supported." << std::endl;
 	return false;
 }
 
+bool Image::OpenFile(MappedFile& file, bool copyOnWrite)
+{
+	if (!preloadedFile.IsOpen()) return file.Open(filePath, copyOnWrite);
+	file = std::move(preloadedFile);     // Loaded contents are writable, like a copy-on-write mapping.
+	return true;
+}
+
 bool Image::ReadBMP24()
 {
-	std::ifstream file(filePath, std::ios::binary);
+	ImageStats::Timer timer(stats, ImageStats::STAGE::DECODE);
+	static_assert(sizeof(RGBPixel) == 3 && std::is_trivially_copyable<RGBPixel>::value, "RGBPixel must have the layout of a 24 bit BMP pixel.");
 
-	if (file) {
-		//Gets how many bytes there are in the stream.
-		file.seekg(0, std::ios::end);           //Sets current character in the stream to the last character(byte).
-		std::streampos length = file.tellg();   //Returns the position of the current character in the input stream.
-		file.seekg(0, std::ios::beg);           //Sets current character in the stream back to the first byte.
+	//The file is decoded straight from the page cache, in MAPPED mode the mapping is kept (copy-on-write) and used as the RGB matrix.
+	MappedFile file;
+	if (!OpenFile(file, readMode == READMODE::MAPPED))
+	{
+		if (verbose) std::cout << "File " << filePath << " does not exist!" << std::endl;
+		return false;
+	}
+	const std::uint64_t length = file.GetSize();
+	if (length < sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER))
+	{
+		if (verbose) std::cout << filePath << " is not a BMP file!" << std::endl;
+		return false;
+	}
 
-		fileBuffer = new char[length];
-		file.read(&fileBuffer[0], length);
+	const BITMAPFILEHEADER* file_header = (const BITMAPFILEHEADER*)file.GetData();                                  //Reads the Bitmap file header (beginning of the file).
+	const BITMAPINFOHEADER* info_header = (const BITMAPINFOHEADER*)(file.GetData() + sizeof(BITMAPFILEHEADER));     //Reads the Bitmap info header (right after file header).
+	if (file_header->bfType == 0x4D42 && info_header->biBitCount <= 8) return ReadBMPIndexed(file.GetData(), length);
+	if (file_header->bfType != (WORD)IMAGEFORMAT::BMP24 || info_header->biBitCount != 24 || info_header->biCompression != 0 || info_header->biWidth <= 0 || info_header->biHeight <= 0)
+	{
+		if (verbose) std::cout << filePath << " is not an uncompressed 24 bit BMP file!" << std::endl;
+		return false;
+	}
+	height = info_header->biHeight;
+	width = info_header->biWidth;
+	xPelsPerMeter = info_header->biXPelsPerMeter;
+	yPelsPerMeter = info_header->biYPelsPerMeter;
+
+	if (verbose) std::cout << "BMP Headers read.\n";
+	format = IMAGEFORMAT::BMP24;
+
+	const std::size_t rowBytes = (std::size_t)width * 3;
+	const int extra = width % 4;   // The nubmer of bytes in a row will be a multiple of 4, this is the padding at the end of each row.
+	const std::uint64_t fileRowBytes = rowBytes + extra;
+	if ((std::uint64_t)file_header->bfOffBits + fileRowBytes * height > length)
+	{
+		if (verbose) std::cout << filePath << " is truncated!" << std::endl;
+		return false;
+	}
+	file.AdviseSequential();
 
-		PBITMAPFILEHEADER file_header;
-		PBITMAPINFOHEADER info_header;
+	//BMP stores the rows bottom-up, so the last row of the file is the first row of the image.
+	unsigned char* pixelData = file.GetData() + file_header->bfOffBits;
+	if (readMode == READMODE::MAPPED)
+	{
+		//No copy at all: the RGB matrix starts at the last row of the file and walks backwards.
+		colourpixels.Attach(pixelData + (height - 1) * fileRowBytes, -(std::ptrdiff_t)fileRowBytes, width, height);
+		mappedFile = std::move(file);
+		ImageStats::Stage& counters = stats[ImageStats::STAGE::DECODE];
+		counters.pixels += (unsigned long long int)width * height;
+		counters.bytesRead += length;     // Counted when mapped, the pages are read in as the pixels are used.
+		if (verbose) std::cout << filePath << " pixel information mapped." << std::endl;
+		return true;
+	}
+
+	const bool storeColour = readMode != READMODE::GREYSCALE;
+	const bool storeGrey = readMode != READMODE::RGB;
+	if ((storeColour && !initPixels()) || (storeGrey && !initGreyscale()))
+	{
+		if (verbose) std::cout << "Not enough memory to read " << filePath << std::endl;
+		colourpixels.Release();
+		greypixels.Release();
+		return false;
+	}
+	if (storeGrey) std::fill_n(frequency, GreyPixel::maxValue + 1, 0);
+	Histogram::Accumulator accumulator;
 
-		file_header = (PBITMAPFILEHEADER)(&fileBuffer[0]);                              //Reads the Bitmap file header (beginning of the file).
-		info_header = (PBITMAPINFOHEADER)(&fileBuffer[0] + sizeof(BITMAPFILEHEADER));   //Reads the Bitmap info header (right after file header).
-		height = info_header->biHeight;
-		width = info_header->biWidth;
-		bufferSize = file_header->bfSize;
+	//RGBPixel has the same Blue, Green, Red layout as the file, a row can be copied as is.
+	//The rows are visited in file order so the read-ahead works.
+	//In the fused modes every row is converted and counted while it is still in the cache.
+	for (unsigned long int r = 0; r < height; r++)
+	{
+		const unsigned long int i = height - 1 - r;
+		const RGBPixel* fileRow = (const RGBPixel*)(pixelData + r * fileRowBytes);
+		if (storeColour)
+		{
+			std::memcpy(colourpixels.Row(i), fileRow, rowBytes);
+			fileRow = colourpixels.Row(i);
+		}
+		if (storeGrey)
+		{
+			GreyPixel* greyRow = greypixels.Row(i);
+			GreyConversion::ConvertRow(fileRow, greyRow, width, greyFormula);
+			accumulator.Add(greyRow, width);
+		}
+	}
+	if (storeGrey)
+	{
+		accumulator.AddTo(frequency);
+		frequencyValid = true;
+		SetPixelsumFromFrequency();
+	}
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::DECODE];
+	counters.pixels += (unsigned long long int)width * height;
+	counters.bytesRead += length;
+	if (verbose) std::cout << filePath << " pixel information read." << std::endl;
+	return true;
+}
 
-		std::cout << "BMP Headers read.\n";
-		format = IMAGEFORMAT::BMP24;
+bool Image::ReadBMPIndexed(const unsigned char* data, std::uint64_t length)
+{
+	const BITMAPFILEHEADER* file_header = (const BITMAPFILEHEADER*)data;
+	const BITMAPINFOHEADER* info_header = (const BITMAPINFOHEADER*)(data + sizeof(BITMAPFILEHEADER));
+	const int bitCount = info_header->biBitCount;
+	const DWORD compression = info_header->biCompression;
+	const bool runLength = (bitCount == 8 && compression == BMPRunLength::rle8) || (bitCount == 4 && compression == BMPRunLength::rle4);
+	if ((bitCount != 1 && bitCount != 4 && bitCount != 8) || (compression != 0 && !runLength) || info_header->biWidth <= 0 || info_header->biHeight <= 0)
+	{
+		if (verbose) std::cout << filePath << " is not a supported indexed BMP file!" << std::endl;
+		return false;
+	}
+	height = info_header->biHeight;
+	width = info_header->biWidth;
+	xPelsPerMeter = info_header->biXPelsPerMeter;
+	yPelsPerMeter = info_header->biYPelsPerMeter;
+
+	//The palette follows the info header (which may be one of the longer versions), missing entries are black.
+	const std::uint32_t maxColours = 1u << bitCount;
+	const std::uint32_t colours = info_header->biClrUsed == 0 || info_header->biClrUsed > maxColours ? maxColours : info_header->biClrUsed;
+	const std::uint64_t paletteOffset = sizeof(BITMAPFILEHEADER) + (std::uint64_t)info_header->biSize;
+	if (paletteOffset + colours * sizeof(RGBQUAD) > length || file_header->bfOffBits > length)
+	{
+		if (verbose) std::cout << filePath << " is truncated!" << std::endl;
+		return false;
+	}
+	RGBPixel paletteColours[256];
+	GreyPixel paletteGreys[256];
+	const RGBQUAD* palette = (const RGBQUAD*)(data + paletteOffset);
+	for (std::uint32_t i = 0; i < colours; i++) paletteColours[i] = RGBPixel(palette[i].rgbRed, palette[i].rgbGreen, palette[i].rgbBlue);
+	GreyConversion::ConvertRow(paletteColours, paletteGreys, 256, greyFormula);
+
+	if (verbose) std::cout << "BMP Headers read.\n";
+	const std::uint64_t fileRowBytes = ((std::uint64_t)width * bitCount + 31) / 32 * 4;
+	const unsigned char* pixelData = data + file_header->bfOffBits;
+	std::vector<unsigned char> decoded;
+	if (runLength)
+	{
+		format = bitCount == 8 ? IMAGEFORMAT::RLE8 : IMAGEFORMAT::RLE4;
+		decoded.assign((std::size_t)width * height, 0);
+		if (!BMPRunLength::Decode(pixelData, (std::size_t)(length - file_header->bfOffBits), bitCount, width, height, decoded.data()))
+		{
+			if (verbose) std::cout << filePath << " is truncated!" << std::endl;
+			return false;
+		}
+	}
+	else
+	{
+		format = bitCount == 1 ? IMAGEFORMAT::BMP1 : IMAGEFORMAT::BMP8;
+		if ((std::uint64_t)file_header->bfOffBits + fileRowBytes * height > length)
+		{
+			if (verbose) std::cout << filePath << " is truncated!" << std::endl;
+			return false;
+		}
+		decoded.resize(width);
+	}
 
-		initPixels();
+	//The indexed pixels can't be used in place, MAPPED reads them like RGB.
+	const bool storeColour = readMode != READMODE::GREYSCALE;
+	const bool storeGrey = readMode == READMODE::FUSED || readMode == READMODE::GREYSCALE;
+	if ((storeColour && !initPixels()) || (storeGrey && !initGreyscale()))
+	{
+		if (verbose) std::cout << "Not enough memory to read " << filePath << std::endl;
+		colourpixels.Release();
+		greypixels.Release();
+		return false;
+	}
+	if (storeGrey) std::fill_n(frequency, GreyPixel::maxValue + 1, 0);
+	Histogram::Accumulator accumulator;
 
-		int count = 1;			// Because this will be substracted from the length to get an index
-		int extra = width % 4;   // The nubmer of bytes in a row (the number of columns) will be a multiple of 4.
-		for (unsigned long int i = 0; i < height; i++)
+	for (unsigned long int r = 0; r < height; r++)
+	{
+		const unsigned long int i = height - 1 - r;
+		const unsigned char* indices;
+		if (runLength) indices = decoded.data() + (std::size_t)r * width;
+		else
 		{
-			count += extra;     // Because of the padding at the end of the row.
-			for (unsigned long int j = width - 1; j < -1; j--)
+			//Unpacks the row into one index per byte, the leftmost pixel is in the highest bits.
+			const unsigned char* fileRow = pixelData + r * fileRowBytes;
+			if (bitCount == 8) indices = fileRow;
+			else
 			{
-				for (int k = 0; k < 3; k++)	//The 3 colours of 1 pixel
-				{
-					//Since BMP has a colour order of Blue, Green, Red and we're reading from the end of the row to the beginning red comes first, followed by green, and finally blue.
-					switch (k) {
-					case 0: //red
-						colourpixels[j][i].Red(fileBuffer[bufferSize - count++]);
-						break;
-					case 1: //green
-						colourpixels[j][i].Green(fileBuffer[bufferSize - count++]);
-						break;
-					case 2: //blue
-						colourpixels[j][i].Blue(fileBuffer[bufferSize - count++]);
-						break;
-					}
-				}
+				const int perByte = 8 / bitCount;
+				const unsigned char mask = (unsigned char)(maxColours - 1);
+				for (unsigned long int j = 0; j < width; j++) decoded[j] = (fileRow[j / perByte] >> (8 - bitCount * (int)(j % perByte + 1))) & mask;
+				indices = decoded.data();
 			}
 		}
-		std::cout << filePath << " pixel information read." << std::endl;
-		return true;
+		if (storeColour)
+		{
+			RGBPixel* colourRow = colourpixels.Row(i);
+			for (unsigned long int j = 0; j < width; j++) colourRow[j] = paletteColours[indices[j]];
+		}
+		if (storeGrey)
+		{
+			GreyPixel* greyRow = greypixels.Row(i);
+			for (unsigned long int j = 0; j < width; j++) greyRow[j] = paletteGreys[indices[j]];
+			accumulator.Add(greyRow, width);
+		}
+	}
+	if (storeGrey)
+	{
+		accumulator.AddTo(frequency);
+		frequencyValid = true;
+		SetPixelsumFromFrequency();
+	}
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::DECODE];
+	counters.pixels += (unsigned long long int)width * height;
+	counters.bytesRead += length;
+	if (verbose) std::cout << filePath << " pixel information read." << std::endl;
+	return true;
+}
+
+bool Image::ReadNetpbm()
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::DECODE);
+	MappedFile file;
+	if (!OpenFile(file, false))
+	{
+		if (verbose) std::cout << "File " << filePath << " does not exist!" << std::endl;
+		return false;
+	}
+	const std::uint64_t length = file.GetSize();
+	const unsigned char* data = file.GetData();
+	Netpbm::Header header;
+	if (!Netpbm::ParseHeader(data, length, header))
+	{
+		if (verbose) std::cout << filePath << " is not a binary PBM, PGM or PPM file!" << std::endl;
+		return false;
+	}
+	if (header.maxValue > GreyPixel::maxValue)
+	{
+		if (verbose) std::cout << filePath << " has 16 bit samples, only 8 bit Netpbm files are supported!" << std::endl;
+		return false;
+	}
+	const std::uint64_t rowBytes = header.RowBytes();
+	if (header.dataOffset + rowBytes * header.height > length)
+	{
+		if (verbose) std::cout << filePath << " is truncated!" << std::endl;
+		return false;
 	}
-	else {
-		std::cout << "File " << filePath << " does not exist!" << std::endl;
+	width = header.width;
+	height = header.height;
+	xPelsPerMeter = yPelsPerMeter = 0;
+	format = header.magic == Netpbm::pbm ? IMAGEFORMAT::PBM : header.magic == Netpbm::pgm ? IMAGEFORMAT::PGM : IMAGEFORMAT::PPM;
+	if (verbose) std::cout << "Netpbm header read.\n";
+	file.AdviseSequential();
+
+	//Samples are scaled to 0-255 when the maximum value is smaller, larger samples than the maximum are white.
+	unsigned char scale[GreyPixel::maxValue + 1];
+	for (unsigned long int v = 0; v <= GreyPixel::maxValue; v++) scale[v] = v >= header.maxValue ? GreyPixel::maxValue : (unsigned char)((v * GreyPixel::maxValue + header.maxValue / 2) / header.maxValue);
+
+	//PGM and PBM files are greyscale already: they always go straight into the greyscale pixels, without conversion,
+	//the RGB pixels are only made (every channel the shade) in RGB and FUSED mode. PPM files are stored like BMP files.
+	const bool colourFile = header.magic == Netpbm::ppm;
+	const bool storeColour = colourFile ? readMode != READMODE::GREYSCALE : readMode == READMODE::RGB || readMode == READMODE::FUSED;
+	const bool storeGrey = colourFile ? readMode == READMODE::FUSED || readMode == READMODE::GREYSCALE : true;
+	if ((storeColour && !initPixels()) || (storeGrey && !initGreyscale()))
+	{
+		if (verbose) std::cout << "Not enough memory to read " << filePath << std::endl;
+		colourpixels.Release();
+		greypixels.Release();
 		return false;
 	}
+	if (storeGrey) std::fill_n(frequency, GreyPixel::maxValue + 1, 0);
+	Histogram::Accumulator accumulator;
+	std::vector<RGBPixel> convertRow(colourFile && !storeColour ? width : 0);
+
+	const unsigned char* pixelData = data + header.dataOffset;
+	for (unsigned long int i = 0; i < height; i++)
+	{
+		const unsigned char* fileRow = pixelData + i * rowBytes;
+		if (colourFile)
+		{
+			//PPM stores Red, Green, Blue.
+			RGBPixel* colourRow = storeColour ? colourpixels.Row(i) : convertRow.data();
+			for (unsigned long int j = 0; j < width; j++) colourRow[j] = RGBPixel(scale[fileRow[3 * j]], scale[fileRow[3 * j + 1]], scale[fileRow[3 * j + 2]]);
+			if (storeGrey)
+			{
+				GreyPixel* greyRow = greypixels.Row(i);
+				GreyConversion::ConvertRow(colourRow, greyRow, width, greyFormula);
+				accumulator.Add(greyRow, width);
+			}
+			continue;
+		}
+
+		GreyPixel* greyRow = greypixels.Row(i);
+		if (header.magic == Netpbm::pbm)
+		{
+			//8 pixels per byte, the leftmost pixel in the highest bit, 1 is black.
+			for (unsigned long int j = 0; j < width; j++) greyRow[j] = (fileRow[j >> 3] >> (7 - (j & 7))) & 1 ? GreyPixel::Black() : GreyPixel::White();
+		}
+		else if (header.maxValue == GreyPixel::maxValue) std::memcpy(greyRow, fileRow, width);
+		else for (unsigned long int j = 0; j < width; j++) greyRow[j] = GreyPixel(scale[fileRow[j]]);
+		accumulator.Add(greyRow, width);
+		if (storeColour)
+		{
+			RGBPixel* colourRow = colourpixels.Row(i);
+			for (unsigned long int j = 0; j < width; j++)
+			{
+				const unsigned char shade = greyRow[j].GetLuminance();
+				colourRow[j] = RGBPixel(shade, shade, shade);
+			}
+		}
+	}
+	if (storeGrey)
+	{
+		accumulator.AddTo(frequency);
+		frequencyValid = true;
+		SetPixelsumFromFrequency();
+	}
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::DECODE];
+	counters.pixels += (unsigned long long int)width * height;
+	counters.bytesRead += length;
+	if (verbose) std::cout << filePath << " pixel information read." << std::endl;
+	return true;
 }
 
 bool Image::Write(std::string nameOfFileToCreate, IMAGEFORMAT format) const
@@ -378,6 +1107,9 @@ bool Image::Write(std::string nameOfFileToCreate, IMAGEFORMAT format) const
 	case Image::IMAGEFORMAT::BMP24:
 		return WriteBMP24(nameOfFileToCreate);
 		break;
+	case Image::IMAGEFORMAT::PPM:
+		return WritePPM(nameOfFileToCreate);
+		break;
 	default:
 	case Image::IMAGEFORMAT::UNKNOWN:
 		std::cerr << "format error" << std::endl;
@@ -386,89 +1118,164 @@ bool Image::Write(std::string nameOfFileToCreate, IMAGEFORMAT format) const
 	}
 }
 
-bool Image::WriteBMP24(std::string nameOfFileToCreate) const
+bool Image::PrepareFileBuffer(std::uint64_t size) const
 {
-	std::ofstream write(nameOfFileToCreate, std::ios::binary);
-	if (!write)
+	//The buffer of the previous write is reused whenever it is large enough.
+	if (fileBuffer == nullptr || bufferCapacity < size)
 	{
-		std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
-		return false;
+		fileBuffer = AllocateFileBuffer(size);
+		if (fileBuffer == nullptr)
+		{
+			bufferSize = bufferCapacity = 0;
+			return false;
+		}
+		bufferCapacity = size;
 	}
-	if (fileBuffer == nullptr)
+	bufferSize = size;
+	return true;
+}
+
+bool Image::PrepareBMPBuffer(unsigned short bitCount, unsigned int compression) const
+{
+	const std::uint32_t colours = bitCount <= 8 ? 1u << bitCount : 0;     // The indexed formats have a palette entry for every index.
+	const std::uint64_t fileRowBytes = ((std::uint64_t)width * bitCount + 31) / 32 * 4;     // The nubmer of bytes in a row will be a multiple of 4.
+	const DWORD offBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + colours * sizeof(RGBQUAD);
+	const std::uint64_t dataSize = compression == 0 ? fileRowBytes * height : BMPRunLength::MaxEncodedSize(width, height);
+
+	if (!PrepareFileBuffer(offBits + dataSize)) return false;
+
+	BITMAPFILEHEADER file_header;
+	file_header.bfType = 0x4D42;
+	file_header.bfReserved1 = 0;
+	file_header.bfReserved2 = 0;
+	file_header.bfOffBits = offBits;
+
+	BITMAPINFOHEADER info_header;
+	info_header.biSize = sizeof(BITMAPINFOHEADER);
+	info_header.biWidth = width;
+	info_header.biHeight = height;
+	info_header.biPlanes = 1;
+	info_header.biBitCount = bitCount;
+	info_header.biCompression = compression;
+	info_header.biXPelsPerMeter = xPelsPerMeter;
+	info_header.biYPelsPerMeter = yPelsPerMeter;
+	info_header.biClrUsed = colours;
+	info_header.biClrImportant = 0;
+
+	std::memcpy(fileBuffer, &file_header, sizeof(BITMAPFILEHEADER));
+	std::memcpy(fileBuffer + sizeof(BITMAPFILEHEADER), &info_header, sizeof(BITMAPINFOHEADER));
+	SetBMPDataSize(dataSize);
+
+	//Grey palette: index i is the shade i * 255 / (colours - 1), the identity for 8 bits, black and white for 1 bit.
+	RGBQUAD* palette = (RGBQUAD*)(fileBuffer + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER));
+	for (std::uint32_t i = 0; i < colours; i++)
 	{
-		bufferSize = (width * 3 + width%4) * height + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+		const BYTE grey = (BYTE)(i * GreyPixel::maxValue / (colours - 1));
+		palette[i] = { grey, grey, grey, 0 };
+	}
+	return true;
+}
 
-		BITMAPFILEHEADER file_header;
-		file_header.bfType = 0x4D42;
-		file_header.bfSize = bufferSize;
-		file_header.bfReserved1 = 0;
-		file_header.bfReserved2 = 0;
-		file_header.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+void Image::SetBMPDataSize(std::uint64_t dataSize) const
+{
+	PBITMAPFILEHEADER file_header = (PBITMAPFILEHEADER)fileBuffer;
+	PBITMAPINFOHEADER info_header = (PBITMAPINFOHEADER)(fileBuffer + sizeof(BITMAPFILEHEADER));
+	bufferSize = file_header->bfOffBits + dataSize;
+	file_header->bfSize = bufferSize > 0xffffffff ? 0 : (DWORD)bufferSize;     // Files over 4 GB can't store their size.
+	info_header->biSizeImage = dataSize > 0xffffffff ? 0 : (DWORD)dataSize;
+}
 
-		BITMAPINFOHEADER info_header;
-		info_header.biSize = sizeof(BITMAPINFOHEADER);
-		info_header.biWidth = width;
-		info_header.biHeight = height;
-		info_header.biPlanes = 1;
-		info_header.biBitCount = 8 * 3;
-		info_header.biCompression = 0;
-		info_header.biSizeImage = bufferSize - file_header.bfOffBits;
-		info_header.biXPelsPerMeter = 0;
-		info_header.biYPelsPerMeter = 0;
-		info_header.biClrUsed = 0;
-		info_header.biClrImportant = 0;
+void Image::EncodeRows(std::uint64_t fileRowBytes, const std::function<void(std::size_t)>& encodeRow) const
+{
+	const std::size_t grain = (std::size_t)std::max<std::uint64_t>(1, (256 * 1024) / std::max<std::uint64_t>(1, fileRowBytes));
+	ThreadPool* pool = GetThreadPool();
+	if (pool != nullptr && height > grain) pool->ParallelFor(height, encodeRow, grain);
+	else for (std::size_t i = 0; i < height; i++) encodeRow(i);
+}
 
-		fileBuffer = new char[bufferSize];
-		for (int i = 0; i < sizeof(BITMAPFILEHEADER); i++)
-		{
-			fileBuffer[i] = ((char*)&file_header)[i];
-		}
-		for (int i = 0; i < sizeof(BITMAPINFOHEADER); i++)
+bool Image::WriteFileBuffer(std::ofstream& write, const std::string& nameOfFileToCreate) const
+{
+	if (writeBehind != nullptr)
+	{
+		write.close();     // Created, the queue writes the contents.
+		if (!writeBehind->Submit(nameOfFileToCreate, fileBuffer, bufferSize))
 		{
-			fileBuffer[sizeof(BITMAPFILEHEADER) + i] = ((char*)&info_header)[i];
+			if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+			return false;
 		}
-		char debug = 'd';
 	}
-	
-	int count = 1;
-	int extra = width % 4;   // The nubmer of bytes in a row (width) will be a multiple of 4.
-	for (unsigned long int i = 0; i < height; i++)
+	else
 	{
-		count += extra;     // Because of the padding.
-		for (unsigned long int j = width - 1; j < -1; j--)
-		{
-			for (int k = 0; k < 3; k++)
-			{
-				switch (k) {
-				case 0: //red
-					fileBuffer[bufferSize - count] = colourpixels[j][i].R();
-					break;
-				case 1: //green
-					fileBuffer[bufferSize - count] = colourpixels[j][i].G();
-					break;
-				case 2: //blue
-					fileBuffer[bufferSize - count] = colourpixels[j][i].B();
-					break;
-				}
-				count++;
-			}
-		}
+		write.write(fileBuffer, (std::streamsize)bufferSize);
+		write.close();
 	}
-	write.write(fileBuffer, bufferSize);
-	write.close();
-	std::cout << nameOfFileToCreate << " file created." << std::endl;
+	ImageStats::Stage& counters = stats[ImageStats::STAGE::ENCODE];
+	counters.pixels += (unsigned long long int)width * height;
+	counters.bytesWritten += bufferSize;
+	if (verbose) std::cout << nameOfFileToCreate << " file created." << std::endl;
 	return true;
 }
 
+bool Image::WriteBMP24(std::string nameOfFileToCreate) const
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
+	std::ofstream write(nameOfFileToCreate, std::ios::binary);
+	if (!write)
+	{
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	if (colourpixels.IsEmpty())
+	{
+		if (verbose) std::cout << "No RGB pixels to write to " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	if (!PrepareBMPBuffer(24))
+	{
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+
+	const std::size_t rowBytes = (std::size_t)width * 3;
+	const int extra = width % 4;   // The nubmer of bytes in a row will be a multiple of 4.
+	char* pixelData = &fileBuffer[((PBITMAPFILEHEADER)fileBuffer)->bfOffBits];
+	EncodeRows(rowBytes + extra, [this, pixelData, rowBytes, extra](std::size_t i)
+	{
+		char* fileRow = pixelData + (height - 1 - i) * (rowBytes + extra);
+		std::memcpy(fileRow, colourpixels.Row((unsigned long int)i), rowBytes);
+		std::memset(fileRow + rowBytes, 0, extra);     // Padding.
+	});
+	return WriteFileBuffer(write, nameOfFileToCreate);
+}
+
 bool Image::WriteGreyscale(std::string nameOfFileToCreate, IMAGEFORMAT format)
 {
 	if (format == IMAGEFORMAT::UNKNOWN) format = this->format;
-	if (greypixels == nullptr) RGBtoGreyscale();
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return false;
 	switch (format)
 	{
 	case Image::IMAGEFORMAT::BMP24:
 		return WriteBMP24Greyscale(nameOfFileToCreate);
 		break;
+	case Image::IMAGEFORMAT::BMP8:
+		return WriteBMP8Greyscale(nameOfFileToCreate);
+		break;
+	case Image::IMAGEFORMAT::BMP1:
+		return WriteBMP1Greyscale(nameOfFileToCreate);
+		break;
+	case Image::IMAGEFORMAT::RLE8:
+		return WriteRLE8Greyscale(nameOfFileToCreate);
+		break;
+	case Image::IMAGEFORMAT::RLE4:
+		return WriteRLE4Greyscale(nameOfFileToCreate);
+		break;
+	case Image::IMAGEFORMAT::PPM:     // The greyscale pixels of a PPM image are written as PGM.
+	case Image::IMAGEFORMAT::PGM:
+		return WritePGM(nameOfFileToCreate);
+		break;
+	case Image::IMAGEFORMAT::PBM:
+		return WritePBM(nameOfFileToCreate);
+		break;
 	default:
 	case Image::IMAGEFORMAT::UNKNOWN:
 		std::cerr << "format error" << std::endl;
@@ -479,69 +1286,196 @@ bool Image::WriteGreyscale(std::string nameOfFileToCreate, IMAGEFORMAT format)
 
 bool Image::WriteBMP24Greyscale(std::string nameOfFileToCreate)
 {
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
 	std::ofstream write(nameOfFileToCreate, std::ios::binary);
 	if (!write)
 	{
-		std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	if (!PrepareBMPBuffer(24))
+	{
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
 		return false;
 	}
-	if (fileBuffer == nullptr)
+	const std::size_t rowBytes = (std::size_t)width * 3;
+	const int extra = width % 4;   // The nubmer of bytes in a row will be a multiple of 4.
+	unsigned char* pixelData = (unsigned char*)&fileBuffer[((PBITMAPFILEHEADER)fileBuffer)->bfOffBits];
+	EncodeRows(rowBytes + extra, [this, pixelData, rowBytes, extra](std::size_t i)
 	{
-		bufferSize = (width * 3 + width % 4) * height + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+		unsigned char* fileRow = pixelData + (height - 1 - i) * (rowBytes + extra);
+		RowEncoder::GreyToBGR(greypixels.Row((unsigned long int)i), width, fileRow);     // Blue, green, red all get the luminance.
+		std::memset(fileRow + rowBytes, 0, extra);     // Padding.
+	});
+	return WriteFileBuffer(write, nameOfFileToCreate);
+}
 
-		BITMAPFILEHEADER file_header;
-		file_header.bfType = 0x4D42;
-		file_header.bfSize = bufferSize;
-		file_header.bfReserved1 = 0;
-		file_header.bfReserved2 = 0;
-		file_header.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+bool Image::WriteBMP8Greyscale(std::string nameOfFileToCreate)
+{
+	static_assert(sizeof(GreyPixel) == 1, "GreyPixel must be a single byte.");
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
+	std::ofstream write(nameOfFileToCreate, std::ios::binary);
+	if (!write)
+	{
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	if (!PrepareBMPBuffer(8))
+	{
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	//The palette maps every index to the same grey shade, so a row of luminances is a row of indices.
+	const std::size_t rowBytes = width;
+	const std::size_t extra = (4 - width % 4) % 4;
+	char* pixelData = &fileBuffer[((PBITMAPFILEHEADER)fileBuffer)->bfOffBits];
+	EncodeRows(rowBytes + extra, [this, pixelData, rowBytes, extra](std::size_t i)
+	{
+		char* fileRow = pixelData + (height - 1 - i) * (rowBytes + extra);
+		std::memcpy(fileRow, greypixels.Row((unsigned long int)i), rowBytes);
+		std::memset(fileRow + rowBytes, 0, extra);     // Padding.
+	});
+	return WriteFileBuffer(write, nameOfFileToCreate);
+}
 
-		BITMAPINFOHEADER info_header;
-		info_header.biSize = sizeof(BITMAPINFOHEADER);
-		info_header.biWidth = width;
-		info_header.biHeight = height;
-		info_header.biPlanes = 1;
-		info_header.biBitCount = 8 * 3;
-		info_header.biCompression = 0;
-		info_header.biSizeImage = bufferSize - file_header.bfOffBits;
-		info_header.biXPelsPerMeter = 0;
-		info_header.biYPelsPerMeter = 0;
-		info_header.biClrUsed = 0;
-		info_header.biClrImportant = 0;
+bool Image::WriteBMP1Greyscale(std::string nameOfFileToCreate)
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
+	std::ofstream write(nameOfFileToCreate, std::ios::binary);
+	if (!write)
+	{
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	if (!PrepareBMPBuffer(1))
+	{
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	//8 pixels per byte, the leftmost pixel in the highest bit. Index 1 of the palette is white, 0 is black.
+	const std::size_t fileRowBytes = ((std::size_t)width + 31) / 32 * 4;
+	const unsigned char threshold = bilevelThreshold.GetLuminance();
+	unsigned char* pixelData = (unsigned char*)&fileBuffer[((PBITMAPFILEHEADER)fileBuffer)->bfOffBits];
+	const std::size_t packedBytes = ((std::size_t)width + 7) / 8;
+	EncodeRows(fileRowBytes, [this, pixelData, fileRowBytes, packedBytes, threshold](std::size_t i)
+	{
+		unsigned char* fileRow = pixelData + (height - 1 - i) * fileRowBytes;
+		RowEncoder::GreyToBits(greypixels.Row((unsigned long int)i), width, threshold, false, fileRow);
+		std::memset(fileRow + packedBytes, 0, fileRowBytes - packedBytes);     // Padding.
+	});
+	return WriteFileBuffer(write, nameOfFileToCreate);
+}
 
-		fileBuffer = new char[bufferSize];
-		for (int i = 0; i < sizeof(BITMAPFILEHEADER); i++)
-		{
-			fileBuffer[i] = ((char*)&file_header)[i];
-		}
-		for (int i = 0; i < sizeof(BITMAPINFOHEADER); i++)
-		{
-			fileBuffer[sizeof(BITMAPFILEHEADER) + i] = ((char*)&info_header)[i];
-		}
-		char debug = 'd';
+bool Image::WriteRLEGreyscale(const std::string& nameOfFileToCreate, unsigned short bitCount)
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
+	std::ofstream write(nameOfFileToCreate, std::ios::binary);
+	if (!write)
+	{
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
 	}
-	int count = 1;
-	int extra = width % 4;   // The nubmer of bytes in a row (width) will be a multiple of 4.
-	for (unsigned long int i = 0; i < height; i++)
+	if (!PrepareBMPBuffer(bitCount, bitCount == 4 ? BMPRunLength::rle4 : BMPRunLength::rle8))
 	{
-		count += extra;     // Because of the padding.
-		for (int j = width - 1; j >= 0; j--)
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+
+	//With 8 bits a row of luminances is a row of palette indices, with 4 bits they are rounded to the nearest of the 16 shades (17 apart).
+	std::vector<unsigned char> indices(bitCount == 4 ? width : 0);
+	unsigned char* const pixelData = (unsigned char*)&fileBuffer[((PBITMAPFILEHEADER)fileBuffer)->bfOffBits];
+	unsigned char* out = pixelData;
+	for (unsigned long int r = 0; r < height; r++)
+	{
+		const unsigned char* row = (const unsigned char*)greypixels.Row(height - 1 - r);
+		if (bitCount == 4)
 		{
-			//red
-			fileBuffer[bufferSize - count] = greypixels[j][i].GetLuminance();
-			count++;
-			//green
-			fileBuffer[bufferSize - count] = greypixels[j][i].GetLuminance();
-			count++;
-			//blue
-			fileBuffer[bufferSize - count] = greypixels[j][i].GetLuminance();
-			count++;
+			for (unsigned long int j = 0; j < width; j++) indices[j] = (unsigned char)((row[j] + 8) / 17);
+			row = indices.data();
 		}
+		out += BMPRunLength::EncodeRow(row, width, bitCount, out);
 	}
-	write.write(fileBuffer, bufferSize);
-	write.close();
-	std::cout << nameOfFileToCreate << " file created." << std::endl;
-	return true;
+	out += BMPRunLength::EncodeEnd(out);
+	SetBMPDataSize((std::uint64_t)(out - pixelData));
+	return WriteFileBuffer(write, nameOfFileToCreate);
+}
+
+bool Image::WritePPM(std::string nameOfFileToCreate) const
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
+	std::ofstream write(nameOfFileToCreate, std::ios::binary);
+	if (!write)
+	{
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	if (colourpixels.IsEmpty())
+	{
+		if (verbose) std::cout << "No RGB pixels to write to " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	const std::string header = Netpbm::FormatHeader(Netpbm::ppm, width, height);
+	if (!PrepareFileBuffer(header.size() + (std::uint64_t)width * 3 * height))
+	{
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	std::memcpy(fileBuffer, header.data(), header.size());
+	unsigned char* pixelData = (unsigned char*)fileBuffer + header.size();
+	//PPM stores Red, Green, Blue top-down.
+	EncodeRows((std::uint64_t)width * 3, [this, pixelData](std::size_t i)
+	{
+		RowEncoder::ColourToRGB(colourpixels.Row((unsigned long int)i), width, pixelData + (std::uint64_t)i * width * 3);
+	});
+	return WriteFileBuffer(write, nameOfFileToCreate);
+}
+
+bool Image::WritePGM(std::string nameOfFileToCreate)
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
+	std::ofstream write(nameOfFileToCreate, std::ios::binary);
+	if (!write)
+	{
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	const std::string header = Netpbm::FormatHeader(Netpbm::pgm, width, height);
+	if (!PrepareFileBuffer(header.size() + (std::uint64_t)width * height))
+	{
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	std::memcpy(fileBuffer, header.data(), header.size());
+	char* pixelData = fileBuffer + header.size();
+	EncodeRows(width, [this, pixelData](std::size_t i) { std::memcpy(pixelData + (std::uint64_t)i * width, greypixels.Row((unsigned long int)i), width); });
+	return WriteFileBuffer(write, nameOfFileToCreate);
+}
+
+bool Image::WritePBM(std::string nameOfFileToCreate)
+{
+	ImageStats::Timer timer(stats, ImageStats::STAGE::ENCODE);
+	std::ofstream write(nameOfFileToCreate, std::ios::binary);
+	if (!write)
+	{
+		if (verbose) std::cout << "Failed to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	const std::string header = Netpbm::FormatHeader(Netpbm::pbm, width, height);
+	const std::size_t rowBytes = ((std::size_t)width + 7) / 8;
+	if (!PrepareFileBuffer(header.size() + (std::uint64_t)rowBytes * height))
+	{
+		if (verbose) std::cout << "Not enough memory to write " << nameOfFileToCreate << std::endl;
+		return false;
+	}
+	std::memcpy(fileBuffer, header.data(), header.size());
+	//8 pixels per byte, the leftmost pixel in the highest bit, 1 is black: the shades below the bilevel threshold.
+	const unsigned char threshold = bilevelThreshold.GetLuminance();
+	unsigned char* pixelData = (unsigned char*)fileBuffer + header.size();
+	EncodeRows(rowBytes, [this, pixelData, rowBytes, threshold](std::size_t i)
+	{
+		RowEncoder::GreyToBits(greypixels.Row((unsigned long int)i), width, threshold, true, pixelData + (std::uint64_t)i * rowBytes);
+	});
+	return WriteFileBuffer(write, nameOfFileToCreate);
 }
 
 void Image::WriteFrequencyToCSV(std::string nameOfFileToCreate, int groupEvery, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
@@ -549,7 +1483,7 @@ void Image::WriteFrequencyToCSV(std::string nameOfFileToCreate, int groupEvery,
 	std::ofstream file;
 	file.open(nameOfFileToCreate, std::ios_base::out);
 	ValidateDimensions(minWidth, minHeight, maxWidth, maxHeight);
-	unsigned int* frequency = GetGreyScaleFrequency(minWidth, minHeight, maxWidth, maxHeight);
+	const Frequency frequency = GetGreyScaleFrequency(minWidth, minHeight, maxWidth, maxHeight);
 
 	file << "Grey shade" << ",";
 	file << "Count" << "\n";
@@ -627,14 +1561,14 @@ void Image::WriteRowGreyShades(std::string nameOfFileToCreate, unsigned long int
 {
 	if (maxCol == 0 || maxCol == minCol) maxCol = GetWidth();
 
-	if (greypixels == nullptr) RGBtoGreyscale();
+	if (greypixels.IsEmpty() && !RGBtoGreyscale()) return;
 
 	std::ofstream file;
 	file.open(nameOfFileToCreate, std::ios_base::out);
 
 	for (unsigned long int i = minCol; i < maxCol; i++)
 	{
-		long long greylvl = (-1 * (long long)(greypixels[row][i].GetLuminance()) + GreyPixel::maxValue);
+		long long greylvl = (-1 * (long long)(greypixels.Row(row)[i].GetLuminance()) + GreyPixel::maxValue);
 		file << std::to_string(greylvl) + "\n";
 	}
 
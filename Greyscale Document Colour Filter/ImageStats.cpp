@@ -0,0 +1,108 @@
+#include "ImageStats.h"
+#include <string>
+#include <cstdio>
+
+ImageStats::Timer::Timer(ImageStats& stats, STAGE stage) : stats(stats)
+{
+	this->stage = stage;
+	parent = stats.current;
+	stats.current = this;
+	stats.currentStage = stage;
+	start = std::chrono::steady_clock::now();
+}
+
+ImageStats::Timer::~Timer()
+{
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	Stage& counters = stats[stage];
+	counters.seconds += seconds - childSeconds;
+	counters.calls++;
+
+	stats.current = parent;
+	if (parent != nullptr)
+	{
+		parent->childSeconds += seconds;
+		stats.currentStage = parent->stage;
+	}
+}
+
+ImageStats& ImageStats::operator=(const ImageStats& Rhs)
+{
+	for (int i = 0; i < stageCount; i++) stages[i] = Rhs.stages[i];
+	return *this;
+}
+
+ImageStats::Stage ImageStats::Total() const
+{
+	Stage total;
+	for (const Stage& stage : stages)
+	{
+		total.seconds += stage.seconds;
+		total.calls += stage.calls;
+		total.pixels += stage.pixels;
+		total.bytesRead += stage.bytesRead;
+		total.bytesWritten += stage.bytesWritten;
+		total.zones += stage.zones;
+		total.allocations += stage.allocations;
+		if (stage.startError > total.startError) total.startError = stage.startError;
+	}
+	return total;
+}
+
+void ImageStats::Reset()
+{
+	for (Stage& stage : stages) stage = Stage();
+}
+
+const char* ImageStats::StageName(STAGE stage)
+{
+	switch (stage)
+	{
+	case STAGE::DECODE: return "decode";
+	case STAGE::CONVERSION: return "conversion";
+	case STAGE::HISTOGRAM: return "histogram";
+	case STAGE::BACKGROUND: return "background";
+	case STAGE::CUT: return "cut";
+	case STAGE::ENCODE: return "encode";
+	}
+	return "unknown";
+}
+
+void ImageStats::WriteJSON(std::ostream& stream) const
+{
+	stream << "{";
+	for (int i = 0; i < stageCount; i++)
+	{
+		const Stage& stage = stages[i];
+		if (i > 0) stream << ",";
+		stream << "\"" << StageName((STAGE)i) << "\":{\"seconds\":" << stage.seconds << ",\"calls\":" << stage.calls << ",\"pixels\":" << stage.pixels
+			<< ",\"bytesRead\":" << stage.bytesRead << ",\"bytesWritten\":" << stage.bytesWritten << ",\"zones\":" << stage.zones
+			<< ",\"allocations\":" << stage.allocations << ",\"startError\":" << stage.startError << "}";
+	}
+	stream << "}";
+}
+
+void ImageStats::WriteJSONString(std::ostream& stream, const std::string& text)
+{
+	stream << "\"";
+	for (const char c : text)
+	{
+		switch (c)
+		{
+		case '"': stream << "\\\""; break;
+		case '\\': stream << "\\\\"; break;
+		case '\n': stream << "\\n"; break;
+		case '\r': stream << "\\r"; break;
+		case '\t': stream << "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char escaped[8];
+				std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)(unsigned char)c);
+				stream << escaped;
+			}
+			else stream << c;
+		}
+	}
+	stream << "\"";
+}
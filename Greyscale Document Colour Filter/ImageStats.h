@@ -0,0 +1,100 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <chrono>
+
+/// <summary>
+/// Wall time and counters of the processing stages of one image.
+/// The times are exclusive: a stage started inside another one (for example the conversion started by the background removal) is only counted once, in the inner stage.
+/// </summary>
+class ImageStats
+{
+public:
+	/// <summary>
+	/// DECODE: reading a file (in FUSED and GREYSCALE mode including the fused conversion and counting).
+	/// CONVERSION: RGB to greyscale conversion. HISTOGRAM: counting grey shade frequencies on request.
+	/// BACKGROUND: background detection and removal. CUT: the CutOut functions. ENCODE: writing a file.
+	/// </summary>
+	enum class STAGE { DECODE, CONVERSION, HISTOGRAM, BACKGROUND, CUT, ENCODE };
+	static const int stageCount = 6;
+
+	struct Stage
+	{
+		double seconds = 0;
+		unsigned long long int calls = 0;
+		unsigned long long int pixels = 0;
+		unsigned long long int bytesRead = 0;
+		unsigned long long int bytesWritten = 0;
+		unsigned long long int zones = 0;
+		/// <summary>
+		/// Buffers (pixel matrices, frequency arrays, write buffers) allocated by the image, from the heap or from its arena.
+		/// </summary>
+		unsigned long long int allocations = 0;
+		/// <summary>
+		/// The largest error bound (in grey shades) of a background start found from a sampled histogram, 0 if every histogram was exact.
+		/// </summary>
+		unsigned long long int startError = 0;
+	};
+
+	/// <summary>
+	/// Measures one call of a stage from its construction to its destruction.
+	/// </summary>
+	class Timer
+	{
+	private:
+		ImageStats& stats;
+		STAGE stage;
+		Timer* parent;
+		std::chrono::steady_clock::time_point start;
+		double childSeconds = 0;
+
+	public:
+		Timer(ImageStats& stats, STAGE stage);
+		~Timer();
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+	};
+
+private:
+	Stage stages[stageCount];
+	/// <summary>
+	/// The innermost running timer, nullptr if no stage is running.
+	/// </summary>
+	Timer* current = nullptr;
+	STAGE currentStage = STAGE::DECODE;
+
+public:
+	inline ImageStats() {}
+	/// <summary>
+	/// Copies the counters only, a copy has no running stage.
+	/// </summary>
+	inline ImageStats(const ImageStats& Rhs) { *this = Rhs; }
+	ImageStats& operator=(const ImageStats& Rhs);
+
+	inline Stage& operator[](STAGE stage) { return stages[(int)stage]; }
+	inline const Stage& operator[](STAGE stage) const { return stages[(int)stage]; }
+	/// <summary>
+	/// The sum of every stage.
+	/// </summary>
+	Stage Total() const;
+
+	/// <summary>
+	/// Counts an allocation in the running stage (allocations outside of every stage are not counted).
+	/// </summary>
+	inline void CountAllocation() { if (current != nullptr) stages[(int)currentStage].allocations++; }
+	void Reset();
+
+	/// <summary>
+	/// The lower case name of the stage, as used in the JSON output.
+	/// </summary>
+	static const char* StageName(STAGE stage);
+	/// <summary>
+	/// Writes the stages as a JSON object (without a line break): {"decode":{"seconds":...,"calls":...,...},...}
+	/// </summary>
+	void WriteJSON(std::ostream& stream) const;
+	/// <summary>
+	/// Writes text as a JSON string, with quotes and escapes.
+	/// </summary>
+	static void WriteJSONString(std::ostream& stream, const std::string& text);
+};
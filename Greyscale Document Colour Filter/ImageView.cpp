@@ -0,0 +1,66 @@
+#include "ImageView.h"
+#include "Image.h"
+#include <cstring>
+
+ImageView::ImageView(const Image& image) : ImageView(image, 0, 0, image.GetWidth(), image.GetHeight())
+{
+}
+
+ImageView::ImageView(const Image& image, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	this->image = &image;
+	if (maxWidth > image.GetWidth()) maxWidth = image.GetWidth();
+	if (maxHeight > image.GetHeight()) maxHeight = image.GetHeight();
+	if (minWidth >= maxWidth || minHeight >= maxHeight) return;
+
+	x = minWidth;
+	y = minHeight;
+	width = maxWidth - minWidth;
+	height = maxHeight - minHeight;
+	if (!image.colourpixels.IsEmpty())
+	{
+		colour = (const unsigned char*)(image.colourpixels.Row(y) + x);
+		colourStride = image.colourpixels.GetStride();
+	}
+	if (!image.greypixels.IsEmpty())
+	{
+		grey = (const unsigned char*)(image.greypixels.Row(y) + x);
+		greyStride = image.greypixels.GetStride();
+	}
+}
+
+ImageView ImageView::Crop(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const
+{
+	if (image == nullptr) return ImageView();
+	if (maxWidth > width) maxWidth = width;
+	if (maxHeight > height) maxHeight = height;
+	return ImageView(*image, x + minWidth, y + minHeight, x + maxWidth, y + maxHeight);
+}
+
+Image ImageView::ToImage() const
+{
+	Image copy(width, height);
+	if (image == nullptr) return copy;
+	copy.CopySettings(*image);
+	copy.width = width;
+	copy.height = height;
+	copy.frequencyValid = false;
+	if (HasColourPixels())
+	{
+		if (!copy.colourpixels.Allocate(width, height, copy.hugePages)) return Image(width, height);     // Not enough memory: no pixels.
+		for (unsigned long int j = 0; j < height; j++) std::memcpy(copy.colourpixels.Row(j), ColourRow(j), (std::size_t)width * sizeof(RGBPixel));
+	}
+	if (HasGreyPixels())
+	{
+		if (!copy.greypixels.Allocate(width, height, copy.hugePages)) return Image(width, height);
+		for (unsigned long int j = 0; j < height; j++) std::memcpy(copy.greypixels.Row(j), GreyRow(j), (std::size_t)width * sizeof(GreyPixel));
+		//Only the rectangle's own toner usage makes sense for the copy.
+		unsigned int* frequency = copy.frequency;
+		std::fill_n(frequency, GreyPixel::maxValue + 1, 0);
+		copy.CountRegion(frequency, 0, 0, width, height);
+		copy.frequencyValid = true;
+		copy.SetPixelsumFromFrequency();
+	}
+	else copy.pixelsum = 0;
+	return copy;
+}
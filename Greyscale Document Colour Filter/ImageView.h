@@ -0,0 +1,86 @@
+#pragma once
+
+#include "RGBPixel.h"
+#include "GreyPixel.h"
+#include <cstddef>
+
+class Image;
+
+/// <summary>
+/// A rectangle of an Image that doesn't own or copy any pixels: the origin and size of the rectangle and the rows and strides of the image's pixel matrices.
+/// Creating one costs the same no matter how large the rectangle is.
+/// The view sees the pixel matrices the image had when the view was created, it is invalidated when the image is destroyed, released or a matrix is (re)created.
+/// </summary>
+class ImageView
+{
+private:
+	const Image* image = nullptr;
+	const unsigned char* colour = nullptr;
+	std::ptrdiff_t colourStride = 0;
+	const unsigned char* grey = nullptr;
+	std::ptrdiff_t greyStride = 0;
+	unsigned long int x = 0;
+	unsigned long int y = 0;
+	unsigned long int width = 0;
+	unsigned long int height = 0;
+
+public:
+	/// <summary>
+	/// An empty view.
+	/// </summary>
+	inline ImageView() {}
+	/// <summary>
+	/// A view of the whole image.
+	/// </summary>
+	explicit ImageView(const Image& image);
+	/// <summary>
+	/// A view of a rectangle of the image. The rectangle is clipped to the image, if nothing is left the view is empty.
+	/// </summary>
+	/// <param name="image">The image the view looks into.</param>
+	/// <param name="minWidth"> The width (x) position of the upper left corner of the rectangle.</param>
+	/// <param name="minHeight">The height (y) position of the upper left corner of the rectangle.</param>
+	/// <param name="maxWidth"> The width (x) position of the lower right corner of the rectangle.</param>
+	/// <param name="maxHeight">The height (y) position of the lower right corner of the rectangle.</param>
+	ImageView(const Image& image, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight);
+
+	inline const Image* GetImage() const { return image; }
+	inline bool IsEmpty() const { return width == 0 || height == 0; }
+	inline unsigned long int GetWidth() const { return width; }
+	inline unsigned long int GetHeight() const { return height; }
+	/// <summary>
+	/// The rectangle in the coordinates of the image, in the minWidth, minHeight, maxWidth, maxHeight form the region functions of Image take.
+	/// </summary>
+	inline unsigned long int GetMinWidth() const { return x; }
+	inline unsigned long int GetMinHeight() const { return y; }
+	inline unsigned long int GetMaxWidth() const { return x + width; }
+	inline unsigned long int GetMaxHeight() const { return y + height; }
+
+	inline bool HasColourPixels() const { return colour != nullptr; }
+	inline bool HasGreyPixels() const { return grey != nullptr; }
+	/// <summary>
+	/// The distance between two rows of the RGB pixels in bytes.
+	/// </summary>
+	inline std::ptrdiff_t GetColourStride() const { return colourStride; }
+	/// <summary>
+	/// The distance between two rows of the greyscale pixels in bytes.
+	/// </summary>
+	inline std::ptrdiff_t GetGreyStride() const { return greyStride; }
+	/// <summary>
+	/// Row j of the view's RGB pixels, pixel 0 is the left edge of the view.
+	/// </summary>
+	inline const RGBPixel* ColourRow(unsigned long int j) const { return (const RGBPixel*)(colour + colourStride * (std::ptrdiff_t)j); }
+	/// <summary>
+	/// Row j of the view's greyscale pixels, pixel 0 is the left edge of the view.
+	/// </summary>
+	inline const GreyPixel* GreyRow(unsigned long int j) const { return (const GreyPixel*)(grey + greyStride * (std::ptrdiff_t)j); }
+
+	/// <summary>
+	/// A view of a rectangle of this view. The coordinates are relative to the view and clipped to it.
+	/// </summary>
+	ImageView Crop(unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight) const;
+	/// <summary>
+	/// Copies the pixels of the view into a new image (when an independent image is really needed).
+	/// If there is not enough memory for the copy it has no pixels (HasPixels() is false).
+	/// </summary>
+	Image ToImage() const;
+};
@@ -0,0 +1,131 @@
+#include "MappedFile.h"
+#include <utility>
+#include <fstream>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& Rhs) noexcept
+{
+	*this = std::move(Rhs);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& Rhs) noexcept
+{
+	if (this != &Rhs)
+	{
+		Close();
+		data = Rhs.data;
+		size = Rhs.size;
+		loaded = std::move(Rhs.loaded);
+		Rhs.data = nullptr;
+		Rhs.size = 0;
+#ifdef _WIN32
+		mapping = Rhs.mapping;
+		Rhs.mapping = nullptr;
+#endif
+	}
+	return *this;
+}
+
+bool MappedFile::Open(const std::string& path, bool copyOnWrite)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	mapping = CreateFileMappingA(file, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);     // The mapping keeps the file open.
+	if (mapping == nullptr) return false;
+
+	data = (unsigned char*)MapViewOfFile(mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+	if (data == nullptr)
+	{
+		CloseHandle(mapping);
+		mapping = nullptr;
+		return false;
+	}
+	size = (std::uint64_t)fileSize.QuadPart;
+#else
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0) return false;
+
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+	const int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+	void* mapped = mmap(nullptr, (std::size_t)status.st_size, protection, MAP_PRIVATE, file, 0);
+	close(file);     // The mapping keeps the file open.
+	if (mapped == MAP_FAILED) return false;
+
+	data = (unsigned char*)mapped;
+	size = (std::uint64_t)status.st_size;
+#endif
+	return true;
+}
+
+bool MappedFile::Load(const std::string& path)
+{
+	Close();
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file) return false;
+	const std::streamoff fileSize = file.tellg();
+	if (fileSize <= 0) return false;
+	std::unique_ptr<unsigned char[]> contents(new (std::nothrow) unsigned char[(std::size_t)fileSize]);
+	if (contents == nullptr) return false;
+	file.seekg(0);
+	if (!file.read((char*)contents.get(), fileSize)) return false;
+
+	loaded = std::move(contents);
+	data = loaded.get();
+	size = (std::uint64_t)fileSize;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (data == nullptr) return;
+	if (loaded != nullptr)
+	{
+		loaded.reset();
+		data = nullptr;
+		size = 0;
+		return;
+	}
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(mapping);
+	mapping = nullptr;
+#else
+	munmap(data, (std::size_t)size);
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+void MappedFile::AdviseSequential()
+{
+	if (data == nullptr || loaded != nullptr) return;
+#ifdef _WIN32
+	//There is no madvise on Windows, the memory manager already clusters the page faults of file views.
+#else
+	madvise(data, (std::size_t)size, MADV_SEQUENTIAL);
+#endif
+}
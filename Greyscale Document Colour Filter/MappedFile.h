@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+/// <summary>
+/// A read only view of a whole file mapped into memory.
+/// The pages are loaded by the operating system when they are first touched, nothing is copied.
+/// A file can also be loaded (read into memory owned by the view), so another thread can read it ahead while the pages would only be faulted in later.
+/// </summary>
+class MappedFile
+{
+private:
+	unsigned char* data = nullptr;
+	std::uint64_t size = 0;
+	/// <summary>
+	/// The contents of a loaded file, data points into it. Empty for a mapped file.
+	/// </summary>
+	std::unique_ptr<unsigned char[]> loaded;
+#ifdef _WIN32
+	void* mapping = nullptr;
+#endif
+
+public:
+	inline MappedFile() {}
+	inline ~MappedFile() { Close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& Rhs) noexcept;
+	MappedFile& operator=(MappedFile&& Rhs) noexcept;
+
+	/// <summary>
+	/// Maps the file into memory. Any previously mapped file is closed.
+	/// </summary>
+	/// <param name="path">The path of the file.</param>
+	/// <param name="copyOnWrite">If true the mapped pages can be written, the changes stay private to this process and never reach the file.</param>
+	/// <returns>true if the file was mapped, false otherwise.</returns>
+	bool Open(const std::string& path, bool copyOnWrite = false);
+	/// <summary>
+	/// Reads the whole file into memory owned by this view. Any previously mapped file is closed.
+	/// The loaded contents can be written (like a copyOnWrite mapping), the changes never reach the file.
+	/// </summary>
+	/// <param name="path">The path of the file.</param>
+	/// <returns>true if the file was read, false otherwise.</returns>
+	bool Load(const std::string& path);
+	/// <summary>
+	/// Unmaps the file (or frees the loaded contents).
+	/// </summary>
+	void Close();
+
+	/// <summary>
+	/// Tells the operating system the file will be read from the beginning to the end, so it can read ahead aggressively.
+	/// </summary>
+	void AdviseSequential();
+
+	inline bool IsOpen() const { return data != nullptr; }
+	inline std::uint64_t GetSize() const { return size; }
+	inline const unsigned char* GetData() const { return data; }
+	/// <summary>
+	/// Only writable if the file was opened with copyOnWrite.
+	/// </summary>
+	inline unsigned char* GetData() { return data; }
+};
@@ -0,0 +1,57 @@
+#include "Netpbm.h"
+
+static bool IsSpace(unsigned char c)
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// <summary>
+/// Reads a decimal number at p, after any whitespace and comments.
+/// </summary>
+static bool ReadNumber(const unsigned char* data, std::uint64_t length, std::uint64_t& p, unsigned long int& value)
+{
+	while (p < length && (IsSpace(data[p]) || data[p] == '#'))
+	{
+		if (data[p] == '#') while (p < length && data[p] != '\n' && data[p] != '\r') p++;
+		else p++;
+	}
+	if (p >= length || data[p] < '0' || data[p] > '9') return false;
+	std::uint64_t number = 0;
+	while (p < length && data[p] >= '0' && data[p] <= '9')
+	{
+		number = number * 10 + (data[p++] - '0');
+		if (number > 0xffffffff) return false;
+	}
+	value = (unsigned long int)number;
+	return true;
+}
+
+std::uint64_t Netpbm::Header::RowBytes() const
+{
+	if (magic == pbm) return ((std::uint64_t)width + 7) / 8;
+	return (std::uint64_t)width * (magic == ppm ? 3 : 1);
+}
+
+bool Netpbm::ParseHeader(const unsigned char* data, std::uint64_t length, Header& header)
+{
+	if (length < 2) return false;
+	header.magic = (std::uint16_t)(data[0] | data[1] << 8);
+	if (header.magic != pbm && header.magic != pgm && header.magic != ppm) return false;
+
+	std::uint64_t p = 2;
+	if (!ReadNumber(data, length, p, header.width) || !ReadNumber(data, length, p, header.height)) return false;
+	header.maxValue = 1;
+	if (header.magic != pbm && !ReadNumber(data, length, p, header.maxValue)) return false;
+	//Exactly one whitespace separates the header from the pixels.
+	if (p >= length || !IsSpace(data[p])) return false;
+	header.dataOffset = p + 1;
+	return header.width > 0 && header.height > 0 && header.maxValue > 0;
+}
+
+std::string Netpbm::FormatHeader(std::uint16_t magic, unsigned long int width, unsigned long int height, unsigned long int maxValue)
+{
+	std::string header = { (char)(magic & 0xff), (char)(magic >> 8), '\n' };
+	header += std::to_string(width) + " " + std::to_string(height) + "\n";
+	if (magic != pbm) header += std::to_string(maxValue) + "\n";
+	return header;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+/// The headers of the binary Netpbm formats: PBM (P4, 1 bit, 1 is black), PGM (P5, greyscale) and PPM (P6, RGB).
+/// A header is the magic number, the width, the height and (except for PBM) the maximum value, in ASCII, separated by whitespace, # starts a comment.
+/// A single whitespace follows the header, then the rows top-down without padding (PBM rows are padded to whole bytes).
+/// </summary>
+class Netpbm
+{
+public:
+	/// <summary>
+	/// The magic numbers as read little-endian from the first two bytes of a file ("P4" is 0x3450).
+	/// </summary>
+	static const std::uint16_t pbm = 0x3450;
+	static const std::uint16_t pgm = 0x3550;
+	static const std::uint16_t ppm = 0x3650;
+
+	struct Header
+	{
+		std::uint16_t magic = 0;
+		unsigned long int width = 0;
+		unsigned long int height = 0;
+		/// <summary>
+		/// The value of white (PGM) or full intensity (PPM), 1 for PBM.
+		/// </summary>
+		unsigned long int maxValue = 0;
+		/// <summary>
+		/// The offset of the first row in the file.
+		/// </summary>
+		std::uint64_t dataOffset = 0;
+
+		/// <summary>
+		/// The number of bytes of a row of pixels.
+		/// </summary>
+		std::uint64_t RowBytes() const;
+	};
+
+	/// <summary>
+	/// Parses the header of a binary PBM, PGM or PPM file.
+	/// </summary>
+	/// <param name="data">The start of the file.</param>
+	/// <param name="length">The size of the file.</param>
+	/// <param name="header">Receives the header.</param>
+	/// <returns>false if the file doesn't start with a valid binary Netpbm header, true otherwise.</returns>
+	static bool ParseHeader(const unsigned char* data, std::uint64_t length, Header& header);
+	/// <summary>
+	/// The header of a file, with the whitespace after it.
+	/// </summary>
+	static std::string FormatHeader(std::uint16_t magic, unsigned long int width, unsigned long int height, unsigned long int maxValue = 255);
+};
@@ -0,0 +1,88 @@
+#include "PageArena.h"
+
+PageArena::PageArena(std::size_t minimumBlockSize, bool useHugePages)
+{
+	this->minimumBlockSize = minimumBlockSize;
+	hugePages = useHugePages;
+}
+
+PageArena::~PageArena()
+{
+	Release();
+}
+
+bool PageArena::AddBlock(std::size_t bytes)
+{
+	//Every new block is at least as big as the previous one, so a growing page needs few blocks.
+	std::size_t size = blocks.empty() ? minimumBlockSize : blocks.back().size;
+	if (size < bytes) size = bytes;
+
+	bool huge = hugePages;
+	unsigned char* data = (unsigned char*)PixelMemory::Allocate(size, huge);
+	if (data == nullptr) return false;
+	blocks.push_back({ data, size, huge });
+	offset = 0;
+	return true;
+}
+
+void* PageArena::Allocate(std::size_t bytes)
+{
+	const std::size_t rounded = (bytes + PixelMemory::alignment - 1) / PixelMemory::alignment * PixelMemory::alignment;
+	if (rounded == 0) return nullptr;
+	if (blocks.empty() || blocks.back().size - offset < rounded)
+	{
+		if (!AddBlock(rounded)) return nullptr;
+	}
+	void* memory = blocks.back().data + offset;
+	offset += rounded;
+	used += rounded;
+	return memory;
+}
+
+void PageArena::Reset()
+{
+	if (blocks.size() > 1)
+	{
+		const std::size_t capacity = GetCapacity();
+		Release();
+		AddBlock(capacity);
+	}
+	offset = 0;
+	used = 0;
+}
+
+void PageArena::Release()
+{
+	for (const Block& block : blocks) PixelMemory::Free(block.data, block.size, block.hugePages);
+	blocks.clear();
+	offset = 0;
+	used = 0;
+}
+
+std::size_t PageArena::GetCapacity() const
+{
+	std::size_t capacity = 0;
+	for (const Block& block : blocks) capacity += block.size;
+	return capacity;
+}
+
+ArenaPool::ArenaPool(bool useHugePages)
+{
+	hugePages = useHugePages;
+}
+
+std::unique_ptr<PageArena> ArenaPool::Acquire()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (arenas.empty()) return std::unique_ptr<PageArena>(new PageArena(16 << 20, hugePages));
+	std::unique_ptr<PageArena> arena = std::move(arenas.back());
+	arenas.pop_back();
+	return arena;
+}
+
+void ArenaPool::Return(std::unique_ptr<PageArena> arena)
+{
+	arena->Reset();
+	std::lock_guard<std::mutex> lock(mutex);
+	arenas.push_back(std::move(arena));
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "PixelPlane.h"
+#include <cstddef>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+/// <summary>
+/// A bump allocator for everything one page (document) needs: pixel planes, histograms and I/O buffers.
+/// Nothing is freed individually, Reset releases every allocation at once and keeps the memory for the next page.
+/// After the first pages the arena is a single block big enough for the largest page, so processing a page makes no allocator calls.
+/// Not thread safe: allocate before starting parallel work on the page.
+/// </summary>
+class PageArena
+{
+private:
+	struct Block
+	{
+		unsigned char* data;
+		std::size_t size;
+		bool hugePages;
+	};
+	std::vector<Block> blocks;
+	/// <summary>
+	/// The bytes used in the last block.
+	/// </summary>
+	std::size_t offset = 0;
+	std::size_t used = 0;
+	std::size_t minimumBlockSize;
+	bool hugePages;
+
+	bool AddBlock(std::size_t bytes);
+
+public:
+	/// <summary>
+	/// Constructor. No memory is allocated until the first Allocate.
+	/// </summary>
+	/// <param name="minimumBlockSize">The smallest block requested from the system.</param>
+	/// <param name="useHugePages">Back the blocks with huge pages if the system allows it.</param>
+	explicit PageArena(std::size_t minimumBlockSize = 16 << 20, bool useHugePages = false);
+	~PageArena();
+
+	PageArena(const PageArena&) = delete;
+	PageArena& operator=(const PageArena&) = delete;
+
+	/// <summary>
+	/// Returns bytes of memory aligned to PixelMemory::alignment. The memory stays valid until Reset or Release.
+	/// </summary>
+	/// <returns>The memory or nullptr if the system is out of memory.</returns>
+	void* Allocate(std::size_t bytes);
+	/// <summary>
+	/// Returns an array of count zero initialized T-s. T must be trivially destructible, no destructor is ever called.
+	/// </summary>
+	template <typename T>
+	T* AllocateArray(std::size_t count)
+	{
+		T* array = (T*)Allocate(count * sizeof(T));
+		if (array != nullptr) std::fill_n(array, count, T());
+		return array;
+	}
+
+	/// <summary>
+	/// Frees every allocation at once. The memory is kept: if the last page needed more than one block they are merged into one.
+	/// </summary>
+	void Reset();
+	/// <summary>
+	/// Frees every allocation and returns the memory to the system.
+	/// </summary>
+	void Release();
+
+	/// <summary>
+	/// The bytes handed out since the last Reset.
+	/// </summary>
+	inline std::size_t GetUsed() const { return used; }
+	/// <summary>
+	/// The bytes reserved from the system.
+	/// </summary>
+	std::size_t GetCapacity() const;
+};
+
+/// <summary>
+/// Arenas reused across pages. A worker takes an arena for a page and gives it back (reset) when the page is done,
+/// so the number of arenas never exceeds the number of pages processed at the same time.
+/// </summary>
+class ArenaPool
+{
+private:
+	std::mutex mutex;
+	std::vector<std::unique_ptr<PageArena>> arenas;
+	bool hugePages;
+
+public:
+	explicit ArenaPool(bool useHugePages = false);
+
+	/// <summary>
+	/// Takes a free arena, or creates one if every arena is in use. Thread safe.
+	/// </summary>
+	std::unique_ptr<PageArena> Acquire();
+	/// <summary>
+	/// Resets the arena and puts it back. Thread safe.
+	/// Everything allocated from the arena must be out of use.
+	/// </summary>
+	void Return(std::unique_ptr<PageArena> arena);
+};
@@ -0,0 +1,109 @@
+#include "ParameterSweep.h"
+#include "Image.h"
+#include "TileHistograms.h"
+#include "Histogram.h"
+#include "ThreadPool.h"
+
+void ParameterSweep::AddGrid(const std::vector<int>& zoneSizes, const std::vector<double>& percents, const std::vector<BackgroundParameters>& windows)
+{
+	for (int zoneSize : zoneSizes)
+	{
+		for (const BackgroundParameters& window : windows)
+		{
+			for (double percent : percents)
+			{
+				Combination combination;
+				combination.zoneSize = zoneSize;
+				combination.parameters = window;
+				combination.parameters.percent = percent;
+				combinations.push_back(combination);
+			}
+		}
+	}
+}
+
+std::vector<ParameterSweep::Result> ParameterSweep::Run(Image& image, ThreadPool* pool) const
+{
+	std::vector<Result> results(combinations.size());
+	//Only read through the const image: the non-const GetGreyPixels forgets the frequency and the toner sum, the sweep doesn't change any pixels.
+	const Image& pixels = image;
+	if (pixels.GetGreyPixels().IsEmpty()) image.RGBtoGreyscale();
+	const PixelPlane<GreyPixel>& plane = pixels.GetGreyPixels();
+	if (plane.IsEmpty()) return results;
+
+	//The whole page is counted once: a grid of zones larger than the page has no zones, but the page still uses its toner.
+	unsigned int page[Histogram::size] = {};
+	Histogram::Accumulator accumulator;
+	for (unsigned long int j = 0; j < plane.GetHeight(); j++) accumulator.Add(plane.Row(j), plane.GetWidth());
+	accumulator.AddTo(page);
+	const unsigned long long int original = Histogram::TonerSum(page);
+	const unsigned long long int inked = Histogram::PixelCount(page, 0, GreyPixel::maxValue - 1);
+
+	//The settings are grouped by zone size: the histograms of a zone size are counted once, the block is reused for the next size.
+	TileHistograms tiles;
+	std::vector<bool> done(combinations.size(), false);
+	for (std::size_t first = 0; first < combinations.size(); first++)
+	{
+		if (done[first]) continue;
+		const int zoneSize = combinations[first].zoneSize;
+		std::vector<std::size_t> group;
+		for (std::size_t k = first; k < combinations.size(); k++)
+		{
+			if (done[k] || combinations[k].zoneSize != zoneSize) continue;
+			group.push_back(k);
+			done[k] = true;
+		}
+
+		const ZoneGrid grid = ZoneGrid::FromZoneSize(zoneSize, 0, 0, image.GetWidth(), image.GetHeight());
+		tiles.Build(plane, grid, pool);
+
+		//The same integer sums as FindAndDeleteBackgroundInGrid: every zone whitens the shades from its start up.
+		auto evaluate = [&](std::size_t g)
+		{
+			const std::size_t k = group[g];
+			unsigned long long int saved = 0;
+			unsigned long long int removed = 0;
+			for (std::size_t zone = 0; zone < tiles.GetZoneCount(); zone++)
+			{
+				const unsigned int* frequency = tiles.Get(zone);
+				const unsigned char start = Image::FindBackgroundStart(frequency, combinations[k].parameters).GetLuminance();
+				saved += Histogram::TonerSum(frequency, start);
+				removed += Histogram::PixelCount(frequency, start, GreyPixel::maxValue - 1);
+			}
+			Result& result = results[k];
+			result.combination = combinations[k];
+			result.zones = tiles.GetZoneCount();
+			result.originalToner = (double)original / GreyPixel::maxValue;
+			result.savedToner = (double)saved / GreyPixel::maxValue;
+			result.inkedPixels = inked;
+			result.removedPixels = removed;
+		};
+		if (pool != nullptr) pool->ParallelFor(group.size(), evaluate, 1);
+		else for (std::size_t g = 0; g < group.size(); g++) evaluate(g);
+	}
+	return results;
+}
+
+std::size_t ParameterSweep::Best(const std::vector<Result>& results, double maxRemovedShare)
+{
+	std::size_t best = results.size();
+	for (std::size_t k = 0; k < results.size(); k++)
+	{
+		if (results[k].RemovedShare() > maxRemovedShare) continue;
+		if (best == results.size() || results[k].savedToner > results[best].savedToner) best = k;
+	}
+	return best;
+}
+
+void ParameterSweep::WriteCSV(std::ostream& stream, const std::vector<Result>& results)
+{
+	stream << "zone size,percent,peak min,peak max,zones,original toner,saved toner,saved percent,removed pixels,removed share\n";
+	for (const Result& result : results)
+	{
+		const BackgroundParameters& parameters = result.combination.parameters;
+		stream << result.combination.zoneSize << "," << parameters.percent << "," << parameters.peakMin << "," << parameters.peakMax << ","
+			<< result.zones << "," << result.originalToner << "," << result.savedToner << "," << result.SavedPercentage() << ","
+			<< result.removedPixels << "," << result.RemovedShare() << "\n";
+	}
+	stream.flush();
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "BackgroundParameters.h"
+#include <vector>
+#include <ostream>
+
+class Image;
+class ThreadPool;
+
+/// <summary>
+/// Evaluates many background removal settings on one decoded document without changing its pixels.
+/// The zone histograms are counted once per zone size (see TileHistograms) and every setting of that zone size is
+/// evaluated from them: the start of the background of every zone, the toner it saves and the pixels it whitens.
+/// The figures are the same as those of FindAndDeleteBackgroundInZones run with the setting.
+/// </summary>
+class ParameterSweep
+{
+public:
+	/// <summary>
+	/// One setting to evaluate.
+	/// </summary>
+	struct Combination
+	{
+		int zoneSize = 100;
+		BackgroundParameters parameters;
+	};
+
+	/// <summary>
+	/// The outcome of one setting.
+	/// </summary>
+	struct Result
+	{
+		Combination combination;
+		unsigned long int zones = 0;
+		/// <summary>
+		/// Toner units the document uses before its background is removed.
+		/// </summary>
+		double originalToner = 0;
+		/// <summary>
+		/// Toner units saved by removing the background.
+		/// </summary>
+		double savedToner = 0;
+		/// <summary>
+		/// Pixels of the document that are not white.
+		/// </summary>
+		unsigned long long int inkedPixels = 0;
+		/// <summary>
+		/// Pixels set to white by removing the background.
+		/// </summary>
+		unsigned long long int removedPixels = 0;
+
+		inline double SavedPercentage() const { return originalToner > 0 ? savedToner / originalToner * 100 : 0; }
+		inline double RemovedShare() const { return inkedPixels > 0 ? (double)removedPixels / inkedPixels : 0; }
+	};
+
+private:
+	std::vector<Combination> combinations;
+
+public:
+	/// <summary>
+	/// Adds a single setting.
+	/// </summary>
+	inline void Add(const Combination& combination) { combinations.push_back(combination); }
+	/// <summary>
+	/// Adds every combination of the zone sizes, falloffs and peak search windows.
+	/// </summary>
+	/// <param name="zoneSizes">The zone sizes.</param>
+	/// <param name="percents">The falloffs (BackgroundParameters::percent).</param>
+	/// <param name="windows">The peak search windows, only peakMin and peakMax are used.</param>
+	void AddGrid(const std::vector<int>& zoneSizes, const std::vector<double>& percents, const std::vector<BackgroundParameters>& windows);
+	inline std::size_t GetCombinationCount() const { return combinations.size(); }
+
+	/// <summary>
+	/// Evaluates every setting on the greyscale pixels of the image, in the order they were added.
+	/// The colour pixels are converted first if the image has no greyscale pixels yet, the greyscale pixels are not changed.
+	/// The histograms of one zone size at a time are kept: zones x 1 KB of memory.
+	/// </summary>
+	/// <param name="image">The document.</param>
+	/// <param name="pool">If not nullptr the histograms are counted and the settings are evaluated in parallel.</param>
+	std::vector<Result> Run(Image& image, ThreadPool* pool = nullptr) const;
+
+	/// <summary>
+	/// The index of the result that saves the most toner while whitening at most maxRemovedShare of the pixels that are not white.
+	/// The first one wins a tie. results.size() if none qualifies.
+	/// </summary>
+	static std::size_t Best(const std::vector<Result>& results, double maxRemovedShare = 1);
+
+	/// <summary>
+	/// Writes a CSV line per result, with a header line.
+	/// </summary>
+	static void WriteCSV(std::ostream& stream, const std::vector<Result>& results);
+};
@@ -0,0 +1,61 @@
+#include "PixelPlane.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+void* PixelMemory::Allocate(std::size_t bytes, bool& hugePages)
+{
+	if (hugePages)
+	{
+#ifdef _WIN32
+		//Large pages need the SeLockMemoryPrivilege, without it VirtualAlloc fails and we fall back to normal pages.
+		const std::size_t largePage = GetLargePageMinimum();
+		if (largePage != 0)
+		{
+			const std::size_t rounded = (bytes + largePage - 1) / largePage * largePage;
+			void* block = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (block != nullptr) return block;
+		}
+#elif defined(MADV_HUGEPAGE)
+		void* block = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (block != MAP_FAILED)
+		{
+			madvise(block, bytes, MADV_HUGEPAGE);   //Only a hint, transparent huge pages may be disabled.
+			return block;
+		}
+#endif
+		hugePages = false;
+	}
+
+#ifdef _WIN32
+	return _aligned_malloc(bytes, alignment);
+#else
+	void* block = nullptr;
+	if (posix_memalign(&block, alignment, bytes) != 0) return nullptr;
+	return block;
+#endif
+}
+
+void PixelMemory::Free(void* block, std::size_t bytes, bool hugePages)
+{
+	if (block == nullptr) return;
+	if (hugePages)
+	{
+#ifdef _WIN32
+		VirtualFree(block, 0, MEM_RELEASE);
+#else
+		munmap(block, bytes);
+#endif
+		return;
+	}
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
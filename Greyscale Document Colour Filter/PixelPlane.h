@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+
+/// <summary>
+/// Raw memory provider for pixel planes. Handles aligned and huge page backed allocations.
+/// </summary>
+class PixelMemory
+{
+public:
+	/// <summary>
+	/// Alignment of every pixel plane allocation and of every row inside a plane (one cache line).
+	/// </summary>
+	static const std::size_t alignment = 64;
+
+	/// <summary>
+	/// Allocates a block of memory aligned to alignment bytes.
+	/// </summary>
+	/// <param name="bytes">The size of the block.</param>
+	/// <param name="hugePages">In: whether huge pages should be tried. Out: whether the block is actually backed by huge pages.</param>
+	/// <returns>The allocated block or nullptr on failure.</returns>
+	static void* Allocate(std::size_t bytes, bool& hugePages);
+	/// <summary>
+	/// Frees a block returned by Allocate.
+	/// </summary>
+	/// <param name="block">The block to free.</param>
+	/// <param name="bytes">The size the block was allocated with.</param>
+	/// <param name="hugePages">The hugePages value Allocate returned for this block.</param>
+	static void Free(void* block, std::size_t bytes, bool hugePages);
+};
+
+/// <summary>
+/// A contiguous, row-major matrix of pixels.
+/// Every row starts on a PixelMemory::alignment boundary, the distance between two rows is the stride (in bytes).
+/// A plane can also be attached to memory it doesn't own (for example a memory mapped file), then the stride can be anything, even negative.
+/// </summary>
+template <typename T>
+class PixelPlane
+{
+private:
+	unsigned char* data = nullptr;
+	std::ptrdiff_t stride = 0;
+	unsigned long int width = 0;
+	unsigned long int height = 0;
+
+	std::size_t allocationSize = 0;
+	bool hugePages = false;
+
+public:
+	inline PixelPlane() {}
+	inline ~PixelPlane() { Release(); }
+
+	PixelPlane(const PixelPlane&) = delete;
+	PixelPlane& operator=(const PixelPlane&) = delete;
+
+	inline PixelPlane(PixelPlane&& Rhs) noexcept { *this = std::move(Rhs); }
+	inline PixelPlane& operator=(PixelPlane&& Rhs) noexcept
+	{
+		if (this != &Rhs)
+		{
+			Release();
+			data = Rhs.data;
+			stride = Rhs.stride;
+			width = Rhs.width;
+			height = Rhs.height;
+			allocationSize = Rhs.allocationSize;
+			hugePages = Rhs.hugePages;
+			Rhs.data = nullptr;
+			Rhs.allocationSize = 0;
+			Rhs.width = Rhs.height = 0;
+			Rhs.stride = 0;
+		}
+		return *this;
+	}
+
+	/// <summary>
+	/// The stride of a plane with width pixels in a row: the row size rounded up to PixelMemory::alignment.
+	/// </summary>
+	static inline std::size_t AlignedStride(unsigned long int width)
+	{
+		return ((std::size_t)width * sizeof(T) + PixelMemory::alignment - 1) / PixelMemory::alignment * PixelMemory::alignment;
+	}
+	/// <summary>
+	/// The number of bytes Allocate and Place need for a plane.
+	/// </summary>
+	static inline std::size_t AllocationSize(unsigned long int width, unsigned long int height) { return AlignedStride(width) * height; }
+
+	/// <summary>
+	/// Allocates the plane and sets every pixel to its default value.
+	/// Any previous content is released.
+	/// </summary>
+	/// <param name="width">Number of pixels in a row.</param>
+	/// <param name="height">Number of rows.</param>
+	/// <param name="useHugePages">Back the plane with huge pages if the system allows it.</param>
+	/// <returns>true if the allocation succeeded, false otherwise.</returns>
+	bool Allocate(unsigned long int width, unsigned long int height, bool useHugePages = false)
+	{
+		Release();
+		const std::size_t alignedRow = AlignedStride(width);
+		const std::size_t bytes = alignedRow * height;
+		if (bytes == 0) return false;
+
+		hugePages = useHugePages;
+		data = (unsigned char*)PixelMemory::Allocate(bytes, hugePages);
+		if (data == nullptr) return false;
+
+		allocationSize = bytes;
+		stride = alignedRow;
+		this->width = width;
+		this->height = height;
+		std::fill_n((T*)data, bytes / sizeof(T), T());
+		return true;
+	}
+
+	/// <summary>
+	/// Lays the plane out in memory owned by someone else (for example a PageArena) and sets every pixel to its default value.
+	/// Any previous content is released. The memory has to stay valid while the plane uses it.
+	/// </summary>
+	/// <param name="block">At least AllocationSize(width, height) bytes aligned to PixelMemory::alignment.</param>
+	/// <param name="width">Number of pixels in a row.</param>
+	/// <param name="height">Number of rows.</param>
+	/// <returns>true if block is not nullptr, false otherwise.</returns>
+	bool Place(void* block, unsigned long int width, unsigned long int height)
+	{
+		Release();
+		if (block == nullptr) return false;
+		Attach(block, AlignedStride(width), width, height);
+		std::fill_n((T*)block, AllocationSize(width, height) / sizeof(T), T());
+		return true;
+	}
+
+	/// <summary>
+	/// Makes the plane use pixels owned by someone else. Any previous content is released.
+	/// The memory has to stay valid while the plane uses it.
+	/// </summary>
+	/// <param name="firstRow">The first pixel of row 0.</param>
+	/// <param name="stride">The distance between the first pixels of two consecutive rows in bytes.</param>
+	/// <param name="width">Number of pixels in a row.</param>
+	/// <param name="height">Number of rows.</param>
+	void Attach(void* firstRow, std::ptrdiff_t stride, unsigned long int width, unsigned long int height)
+	{
+		Release();
+		data = (unsigned char*)firstRow;
+		this->stride = stride;
+		this->width = width;
+		this->height = height;
+	}
+
+	/// <summary>
+	/// Frees the pixels of the plane (or detaches it if it doesn't own them).
+	/// </summary>
+	void Release()
+	{
+		if (allocationSize != 0) PixelMemory::Free(data, allocationSize, hugePages);
+		data = nullptr;
+		allocationSize = 0;
+		stride = 0;
+		width = height = 0;
+	}
+
+	inline bool IsEmpty() const { return data == nullptr; }
+	inline bool IsOwning() const { return allocationSize != 0; }
+	inline unsigned long int GetWidth() const { return width; }
+	inline unsigned long int GetHeight() const { return height; }
+	/// <summary>
+	/// The distance between the first pixels of two consecutive rows in bytes.
+	/// </summary>
+	inline std::ptrdiff_t GetStride() const { return stride; }
+	inline bool IsHugePageBacked() const { return hugePages; }
+
+	inline T* Row(unsigned long int y) { return (T*)(data + stride * (std::ptrdiff_t)y); }
+	inline const T* Row(unsigned long int y) const { return (const T*)(data + stride * (std::ptrdiff_t)y); }
+
+	inline T& operator()(unsigned long int x, unsigned long int y) { return Row(y)[x]; }
+	inline const T& operator()(unsigned long int x, unsigned long int y) const { return Row(y)[x]; }
+};
@@ -1,13 +1,14 @@
 #include "RGBPixel.h"
+#include "GreyConversion.h"
 
 unsigned char const RGBPixel::RGBtoGreyAverage() const
 {
-	return red / 3 + green / 3 + blue / 3;
+	return GreyConversion::Average(red, green, blue);
 }
 
 unsigned char const RGBPixel::RGBtoGreyWeighted() const
 {
-	return char(0.2126 * red + 0.7152 * green + 0.0722 * blue);
+	return GreyConversion::Weighted(red, green, blue);
 }
 
 RGBPixel::RGBPixel()
@@ -33,8 +34,7 @@ void RGBPixel::Set(const unsigned char red, const unsigned char green, const uns
 
 GreyPixel RGBPixel::toGrey()
 {
-	//return GreyPixel(RGBtoGreyAverage());
-	return GreyPixel(RGBtoGreyWeighted());
+	return ToGrey<GreyConversion::Rec709>();
 }
 
 unsigned char const RGBPixel::Red() const
@@ -67,14 +67,6 @@ unsigned char RGBPixel::Blue(char blue)
 	return this->blue = blue;
 }
 
-RGBPixel RGBPixel::operator=(const RGBPixel& Rhs)
-{
-	red = Rhs.red;
-	green = Rhs.green;
-	blue = Rhs.blue;
-	return *this;
-}
-
 bool RGBPixel::operator==(const RGBPixel& Rhs)
 {
 	return (red == Rhs.red) && (green == Rhs.green) && (blue == Rhs.blue);
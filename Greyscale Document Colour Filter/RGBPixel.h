@@ -4,18 +4,20 @@
 class RGBPixel
 {
 protected:
+	//The components are stored in the same order as in the pixel array of a BMP file (Blue, Green, Red),
+	//so a row of RGBPixels has the exact memory layout of a 24 bit BMP row.
 	/// <summary>
-	/// Red value.
+	/// Blue value.
 	/// </summary>
-	unsigned char red;
+	unsigned char blue;
 	/// <summary>
 	/// Green value.
 	/// </summary>
 	unsigned char green;
 	/// <summary>
-	/// Blue value.
+	/// Red value.
 	/// </summary>
-	unsigned char blue;
+	unsigned char red;
 
 	/// <summary>
 	/// Converts colour from RGB colour space to greyscale.
@@ -27,7 +29,7 @@ protected:
 	/// <summary>
 	/// Converts colour from RGB colour space to greyscale.
 	/// Uses the weighted formula.
-	/// 0.299 * Red + 0.587 * Green + 0.114 * Blue
+	/// 0.2126 * Red + 0.7152 * Green + 0.0722 * Blue (in fixed-point, see GreyConversion)
 	/// </summary>
 	/// <returns>The luminance value as a single number between 0-255.</returns>
 	unsigned char const RGBtoGreyWeighted() const;
@@ -53,8 +55,16 @@ public:
 	/// <param name="blue">Blue component. 0-255</param>
 	void Set(const unsigned char red, const unsigned char green, const unsigned char blue);
 
+	/// <summary>
+	/// Converts the colour to greyscale with the Rec. 709 weighted formula.
+	/// </summary>
 	GreyPixel toGrey();
 	/// <summary>
+	/// Converts the colour to greyscale with a formula policy of GreyConversion (Rec709, Rec601, Average3, Channel, Weights).
+	/// </summary>
+	template <class Formula>
+	inline GreyPixel ToGrey() const { return GreyPixel(Formula::Convert(red, green, blue)); }
+	/// <summary>
 	/// Getter. Returns the value of red.
 	/// </summary>
 	/// <returns>The value of red. 0-255</returns>
@@ -116,7 +126,6 @@ public:
 	/// <returns>The value of blue.</returns>
 	unsigned char Blue(char blue);
 	
-	RGBPixel operator=(const RGBPixel& Rhs);
 	bool operator==(const RGBPixel &Rhs);
 	inline bool operator!=(const RGBPixel& Rhs) { return !(this == &Rhs); }
 
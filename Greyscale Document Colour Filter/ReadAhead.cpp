@@ -0,0 +1,58 @@
+#include "ReadAhead.h"
+#include <algorithm>
+
+ReadAhead::ReadAhead(const std::vector<std::string>& paths, std::size_t depth, std::uint64_t maxBytes) : paths(paths), files(paths.size()), done(paths.size(), false)
+{
+	this->depth = std::max<std::size_t>(1, depth);
+	this->maxBytes = maxBytes;
+	loader = std::thread(&ReadAhead::LoaderLoop, this);
+}
+
+ReadAhead::~ReadAhead()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taken.notify_all();
+	loader.join();
+}
+
+void ReadAhead::LoaderLoop()
+{
+	for (std::size_t i = 0; i < paths.size(); i++)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taken.wait(lock, [this] { return stopping || (waiting < depth && (waiting == 0 || waitingBytes < maxBytes)); });
+			if (stopping) return;
+		}
+
+		//The file is read without the lock, Take only waits for the files that are done.
+		MappedFile file;
+		file.Load(paths[i]);
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			waiting++;
+			waitingBytes += file.GetSize();
+			files[i] = std::move(file);
+			done[i] = true;
+		}
+		loaded.notify_all();
+	}
+}
+
+MappedFile ReadAhead::Take(std::size_t index)
+{
+	MappedFile file;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		loaded.wait(lock, [this, index] { return (bool)done[index]; });
+		file = std::move(files[index]);
+		waiting--;
+		waitingBytes -= file.GetSize();
+	}
+	taken.notify_all();
+	return file;
+}
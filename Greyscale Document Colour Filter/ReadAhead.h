@@ -0,0 +1,58 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+
+/// <summary>
+/// Loads a list of files into memory on a background thread, in order, ahead of the documents being processed.
+/// At most depth loaded files wait to be taken, and they use at most maxBytes together (a single larger file is still loaded).
+/// The files should be taken roughly in order, the loader never skips a file.
+/// </summary>
+class ReadAhead
+{
+private:
+	std::vector<std::string> paths;
+	std::vector<MappedFile> files;
+	std::vector<bool> done;
+	std::size_t depth;
+	std::uint64_t maxBytes;
+
+	std::size_t waiting = 0;
+	std::uint64_t waitingBytes = 0;
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable loaded;
+	std::condition_variable taken;
+	std::thread loader;
+
+	void LoaderLoop();
+
+public:
+	/// <summary>
+	/// Constructor. Starts loading the first files.
+	/// </summary>
+	/// <param name="paths">The files, in the order they will be taken.</param>
+	/// <param name="depth">The most loaded files waiting to be taken. At least 1.</param>
+	/// <param name="maxBytes">The most memory the waiting files use together.</param>
+	ReadAhead(const std::vector<std::string>& paths, std::size_t depth, std::uint64_t maxBytes);
+	/// <summary>
+	/// Destructor. Stops the loader, the files not taken yet are freed.
+	/// </summary>
+	~ReadAhead();
+
+	ReadAhead(const ReadAhead&) = delete;
+	ReadAhead& operator=(const ReadAhead&) = delete;
+
+	/// <summary>
+	/// Waits until the file is loaded and takes it over. Every file can only be taken once.
+	/// </summary>
+	/// <param name="index">The index of the file in paths.</param>
+	/// <returns>The loaded file, or a closed MappedFile if it couldn't be read (the caller opens it itself to report the error).</returns>
+	MappedFile Take(std::size_t index);
+};
@@ -0,0 +1,41 @@
+#include "RowEncoder.h"
+#include <cstring>
+
+static_assert(sizeof(GreyPixel) == 1, "GreyPixel must be a single byte.");
+static_assert(sizeof(RGBPixel) == 3, "RGBPixel must be 3 bytes: Blue, Green, Red.");
+
+void RowEncoder::GreyToBGR(const GreyPixel* pixels, std::size_t count, unsigned char* destination)
+{
+	const unsigned char* shades = (const unsigned char*)pixels;
+	for (std::size_t j = 0; j < count; j++) destination[3 * j] = destination[3 * j + 1] = destination[3 * j + 2] = shades[j];
+}
+
+void RowEncoder::ColourToRGB(const RGBPixel* pixels, std::size_t count, unsigned char* destination)
+{
+	const unsigned char* bytes = (const unsigned char*)pixels;
+	for (std::size_t j = 0; j < 3 * count; j += 3)
+	{
+		destination[j] = bytes[j + 2];
+		destination[j + 1] = bytes[j + 1];
+		destination[j + 2] = bytes[j];
+	}
+}
+
+void RowEncoder::GreyToBits(const GreyPixel* pixels, std::size_t count, unsigned char threshold, bool darkIsOne, unsigned char* destination)
+{
+	const unsigned char* shades = (const unsigned char*)pixels;
+	const unsigned char flip = darkIsOne ? 0xff : 0;
+	std::size_t j = 0;
+	for (; j + 8 <= count; j += 8)
+	{
+		unsigned char bits = 0;
+		for (int k = 0; k < 8; k++) bits = (unsigned char)(bits << 1 | (shades[j + k] >= threshold));
+		destination[j >> 3] = bits ^ flip;
+	}
+	if (j < count)
+	{
+		unsigned char bits = 0;
+		for (std::size_t k = j; k < count; k++) bits |= (unsigned char)(((shades[k] >= threshold) ^ (flip & 1)) << (7 - (k - j)));
+		destination[j >> 3] = bits;
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "GreyPixel.h"
+#include "RGBPixel.h"
+#include <cstddef>
+
+/// <summary>
+/// Converts rows of pixels to the pixel layouts of the output files.
+/// The rows are independent, so the writers can run them on different threads, each into its own part of the file buffer.
+/// </summary>
+class RowEncoder
+{
+public:
+	/// <summary>
+	/// Writes every grey shade three times: the blue, green and red bytes of a 24 bit BMP pixel.
+	/// </summary>
+	/// <param name="pixels">The first pixel.</param>
+	/// <param name="count">The number of pixels.</param>
+	/// <param name="destination">Where to write, 3 * count bytes.</param>
+	static void GreyToBGR(const GreyPixel* pixels, std::size_t count, unsigned char* destination);
+	/// <summary>
+	/// Writes the pixels in Red, Green, Blue byte order (PPM), RGBPixel stores Blue, Green, Red.
+	/// </summary>
+	/// <param name="pixels">The first pixel.</param>
+	/// <param name="count">The number of pixels.</param>
+	/// <param name="destination">Where to write, 3 * count bytes.</param>
+	static void ColourToRGB(const RGBPixel* pixels, std::size_t count, unsigned char* destination);
+	/// <summary>
+	/// Packs 8 pixels per byte, the leftmost pixel in the highest bit. The last byte is padded with 0 bits.
+	/// </summary>
+	/// <param name="pixels">The first pixel.</param>
+	/// <param name="count">The number of pixels.</param>
+	/// <param name="threshold">The shades from threshold up are light, the ones below are dark.</param>
+	/// <param name="darkIsOne">true: the dark pixels are 1 bits (PBM), false: the light pixels are (BMP with a black, white palette).</param>
+	/// <param name="destination">Where to write, (count + 7) / 8 bytes.</param>
+	static void GreyToBits(const GreyPixel* pixels, std::size_t count, unsigned char threshold, bool darkIsOne, unsigned char* destination);
+};
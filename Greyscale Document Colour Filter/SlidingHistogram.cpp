@@ -0,0 +1,192 @@
+#include "SlidingHistogram.h"
+#include <algorithm>
+
+std::size_t SlidingHistogram::MemorySize(unsigned long int width)
+{
+	return (std::size_t)width * (Histogram::size + buckets) * sizeof(std::uint16_t);
+}
+
+SlidingHistogram::SlidingHistogram(unsigned long int width, unsigned long int radius, void* memory)
+{
+	this->width = width;
+	this->radius = radius;
+	if (memory == nullptr)
+	{
+		ownColumns.resize(MemorySize(width) / sizeof(std::uint16_t));
+		memory = ownColumns.data();
+	}
+	else std::fill_n((std::uint16_t*)memory, MemorySize(width) / sizeof(std::uint16_t), 0);
+	columns = (std::uint16_t*)memory;
+	columnBuckets = columns + (std::size_t)width * Histogram::size;
+	std::fill_n(window, Histogram::size, 0);
+	std::fill_n(windowBuckets, buckets, 0);
+	std::fill_n(refreshed, buckets, stale);
+	bucketsRefreshed = stale;
+}
+
+void SlidingHistogram::AddRow(const GreyPixel* row)
+{
+	std::uint16_t* counts = columns;
+	std::uint16_t* coarse = columnBuckets;
+	for (unsigned long int x = 0; x < width; x++, counts += Histogram::size, coarse += buckets)
+	{
+		const unsigned char shade = row[x].GetLuminance();
+		counts[shade]++;
+		coarse[shade >> bucketBits]++;
+	}
+}
+
+void SlidingHistogram::RemoveRow(const GreyPixel* row)
+{
+	std::uint16_t* counts = columns;
+	std::uint16_t* coarse = columnBuckets;
+	for (unsigned long int x = 0; x < width; x++, counts += Histogram::size, coarse += buckets)
+	{
+		const unsigned char shade = row[x].GetLuminance();
+		counts[shade]--;
+		coarse[shade >> bucketBits]--;
+	}
+}
+
+void SlidingHistogram::StartRow()
+{
+	centre = 0;
+	bucketsRefreshed = stale;
+	std::fill_n(refreshed, buckets, stale);
+}
+
+//The updates are plain loops over a fixed number of counts, the compiler vectorizes them.
+//Catching up column by column touches two columns per step, counting the window from scratch touches all of its columns once.
+
+template <int count>
+void SlidingHistogram::BringUpToDate(unsigned int* counts, const std::uint16_t* columnCounts, std::size_t stride, unsigned long int since) const
+{
+	const unsigned long int first = centre > radius ? centre - radius : 0;
+	const unsigned long int last = std::min(centre + radius, width - 1);
+	if (since != stale && 2 * (centre - since) <= last - first + 1)
+	{
+		for (unsigned long int x = since + 1; x <= centre; x++)
+		{
+			if (x + radius < width)
+			{
+				const std::uint16_t* entering = &columnCounts[(std::size_t)(x + radius) * stride];
+				for (int i = 0; i < count; i++) counts[i] += entering[i];
+			}
+			if (x > radius)
+			{
+				const std::uint16_t* leaving = &columnCounts[(std::size_t)(x - radius - 1) * stride];
+				for (int i = 0; i < count; i++) counts[i] -= leaving[i];
+			}
+		}
+		return;
+	}
+	std::fill_n(counts, count, 0);
+	for (unsigned long int x = first; x <= last; x++)
+	{
+		const std::uint16_t* column = &columnCounts[(std::size_t)x * stride];
+		for (int i = 0; i < count; i++) counts[i] += column[i];
+	}
+}
+
+void SlidingHistogram::RefreshBuckets()
+{
+	if (bucketsRefreshed == centre) return;
+	BringUpToDate<buckets>(windowBuckets, columnBuckets, buckets, bucketsRefreshed);
+	bucketsRefreshed = centre;
+}
+
+void SlidingHistogram::Refresh(int bucket)
+{
+	if (refreshed[bucket] == centre) return;
+	BringUpToDate<bucketSize>(&window[bucket * bucketSize], &columns[bucket * bucketSize], Histogram::size, refreshed[bucket]);
+	refreshed[bucket] = centre;
+}
+
+const unsigned int* SlidingHistogram::Get()
+{
+	RefreshBuckets();
+	for (int bucket = 0; bucket < buckets; bucket++) Refresh(bucket);
+	return window;
+}
+
+unsigned int SlidingHistogram::FindPeak(const BackgroundParameters& parameters)
+{
+	RefreshBuckets();
+
+	//The same search as Image::FindBackgroundStart: the first most frequent shade in [low, high).
+	const unsigned int high = std::min<unsigned int>(parameters.peakMax, Histogram::size);
+	const unsigned int low = std::min(parameters.peakMin, high > 0 ? high - 1 : 0);
+	if (high <= low) return low;
+	const int firstBucket = low >> bucketBits;
+	const int lastBucket = (high - 1) >> bucketBits;
+
+	//A shade is never more frequent than its bucket: the fullest bucket is searched first, then only the buckets that could hold a more frequent shade.
+	int fullest = firstBucket;
+	for (int bucket = firstBucket + 1; bucket <= lastBucket; bucket++)
+	{
+		if (windowBuckets[bucket] > windowBuckets[fullest]) fullest = bucket;
+	}
+	unsigned int peakFrequency = 0;
+	auto search = [&](int bucket)
+	{
+		Refresh(bucket);
+		const unsigned int end = std::min<unsigned int>(high, (bucket + 1) * bucketSize);
+		for (unsigned int i = std::max<unsigned int>(low, bucket * bucketSize); i < end; i++) peakFrequency = std::max(peakFrequency, window[i]);
+	};
+	search(fullest);
+	for (int bucket = firstBucket; bucket <= lastBucket; bucket++)
+	{
+		if (bucket != fullest && windowBuckets[bucket] > peakFrequency) search(bucket);
+	}
+
+	//The first shade that frequent, in a bucket that could hold it.
+	for (int bucket = firstBucket; bucket <= lastBucket; bucket++)
+	{
+		if (windowBuckets[bucket] < peakFrequency) continue;
+		Refresh(bucket);
+		const unsigned int end = std::min<unsigned int>(high, (bucket + 1) * bucketSize);
+		for (unsigned int i = std::max<unsigned int>(low, bucket * bucketSize); i < end; i++)
+		{
+			if (window[i] == peakFrequency) return i;
+		}
+	}
+	return low;
+}
+
+unsigned int SlidingHistogram::WalkDown(unsigned int peak, double limit, unsigned int floor)
+{
+	unsigned int start = peak;
+	while (start > floor)
+	{
+		//A bucket that isn't above the limit has no shade above it either, the walk stops without bringing the bucket up to date.
+		const int bucket = start >> bucketBits;
+		if (windowBuckets[bucket] <= limit) break;
+		if (Frequency(start) <= limit) break;
+		start--;
+	}
+	return start;
+}
+
+GreyPixel SlidingHistogram::FindBackgroundStart(const BackgroundParameters& parameters)
+{
+	const unsigned int peak = FindPeak(parameters);
+	return GreyPixel((unsigned char)WalkDown(peak, Frequency(peak) * parameters.percent, 0));
+}
+
+bool SlidingHistogram::IsBackground(unsigned int shade, const BackgroundParameters& parameters)
+{
+	//The peak is never above the last searched shade, and the background starts at or below the peak.
+	const unsigned int high = std::min<unsigned int>(parameters.peakMax, Histogram::size);
+	if (shade + 1 >= high) return true;
+	const unsigned int peak = FindPeak(parameters);
+	if (shade >= peak) return true;
+
+	//The start is at or below shade exactly when every shade above it, up to the peak, is above the limit.
+	//A bucket between them that isn't above the limit decides it without counting any shades.
+	const double limit = Frequency(peak) * parameters.percent;
+	for (unsigned int bucket = (shade + bucketSize) >> bucketBits; (bucket + 1) * bucketSize <= peak + 1; bucket++)
+	{
+		if (windowBuckets[bucket] <= limit) return false;
+	}
+	return WalkDown(peak, limit, shade) <= shade;
+}
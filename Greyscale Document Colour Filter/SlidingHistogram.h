@@ -0,0 +1,115 @@
+#pragma once
+
+#include "GreyPixel.h"
+#include "Histogram.h"
+#include "BackgroundParameters.h"
+#include <vector>
+#include <cstdint>
+
+/// <summary>
+/// The grey shade frequencies of a square window sliding over a band of rows, updated incrementally (Perreault and Hebert's median filter scheme).
+/// Every column keeps the frequencies of its pixels in the rows of the window. Moving the window down adds the entering row and removes the leaving one
+/// from the column histograms (one count per column), moving it right adds the entering column histograms to the window and subtracts the leaving ones.
+/// The histograms have two levels: 16 coarse buckets of 16 shades each, and the shades themselves. Both are brought up to date when they are read,
+/// so the pixels that need no threshold and the buckets the background detection never looks at cost nothing.
+/// The cost per pixel doesn't depend on the size of the window.
+/// </summary>
+class SlidingHistogram
+{
+private:
+	static const int bucketBits = 4;
+	static const int bucketSize = 1 << bucketBits;
+	static const int buckets = Histogram::size / bucketSize;
+	/// <summary>
+	/// The column a bucket of shades has never been brought up to date at (since StartRow).
+	/// </summary>
+	static constexpr unsigned long int stale = ~0ul;
+
+	/// <summary>
+	/// Histogram::size shade counts per column, then buckets coarse counts per column.
+	/// </summary>
+	std::uint16_t* columns;
+	std::uint16_t* columnBuckets;
+	/// <summary>
+	/// The block of the column counts when no memory was given to the constructor.
+	/// </summary>
+	std::vector<std::uint16_t> ownColumns;
+	unsigned int window[Histogram::size];
+	unsigned int windowBuckets[buckets];
+	/// <summary>
+	/// The centre column windowBuckets was last brought up to date at.
+	/// </summary>
+	unsigned long int bucketsRefreshed;
+	/// <summary>
+	/// The centre column every bucket of window was last brought up to date at.
+	/// </summary>
+	unsigned long int refreshed[buckets];
+	unsigned long int width;
+	unsigned long int radius;
+	unsigned long int centre = 0;
+
+	/// <summary>
+	/// Brings count window counts from the centre column since (stale: from nothing) to the current centre.
+	/// </summary>
+	/// <param name="counts">The window counts.</param>
+	/// <param name="columnCounts">The same counts of column 0, the next column is stride counts further.</param>
+	template <int count>
+	void BringUpToDate(unsigned int* counts, const std::uint16_t* columnCounts, std::size_t stride, unsigned long int since) const;
+	void RefreshBuckets();
+	void Refresh(int bucket);
+	inline unsigned int Frequency(unsigned int shade) { Refresh(shade >> bucketBits); return window[shade]; }
+	/// <summary>
+	/// The first most frequent shade in the peak search window of the parameters.
+	/// </summary>
+	unsigned int FindPeak(const BackgroundParameters& parameters);
+	/// <summary>
+	/// Walks down from the peak while the frequency is above limit, like Image::FindBackgroundStart, but not below floor.
+	/// </summary>
+	unsigned int WalkDown(unsigned int peak, double limit, unsigned int floor);
+
+public:
+	/// <summary>
+	/// The bytes of memory the column counts of width columns use.
+	/// </summary>
+	static std::size_t MemorySize(unsigned long int width);
+
+	/// <summary>
+	/// Constructor. The column histograms start empty.
+	/// </summary>
+	/// <param name="width">The number of columns.</param>
+	/// <param name="radius">The window covers the columns [x - radius, x + radius] around its centre x (clipped to the columns). At most 32767.</param>
+	/// <param name="memory">MemorySize(width) bytes for the column counts, aligned for std::uint16_t, valid while the histogram is used. nullptr: allocated by the histogram.</param>
+	SlidingHistogram(unsigned long int width, unsigned long int radius, void* memory = nullptr);
+
+	/// <summary>
+	/// Adds a row (of width pixels) to the column histograms.
+	/// </summary>
+	void AddRow(const GreyPixel* row);
+	/// <summary>
+	/// Removes a row that was added before from the column histograms.
+	/// </summary>
+	void RemoveRow(const GreyPixel* row);
+
+	/// <summary>
+	/// Puts the centre of the window on column 0.
+	/// </summary>
+	void StartRow();
+	/// <summary>
+	/// Moves the centre of the window right to column x (not left of the centre).
+	/// </summary>
+	inline void MoveTo(unsigned long int x) { centre = x; }
+
+	/// <summary>
+	/// The frequency of the grey shades in the window. Brings every bucket up to date, the background detection doesn't need this.
+	/// </summary>
+	const unsigned int* Get();
+	/// <summary>
+	/// The start of the background in the window: the same as Image::FindBackgroundStart(Get(), parameters), reading only the buckets it needs.
+	/// </summary>
+	GreyPixel FindBackgroundStart(const BackgroundParameters& parameters);
+	/// <summary>
+	/// Whether shade is at or above the start of the background in the window. The walk down from the peak stops at shade,
+	/// so a shade close to the background peak is decided without finding where the background starts.
+	/// </summary>
+	bool IsBackground(unsigned int shade, const BackgroundParameters& parameters);
+};
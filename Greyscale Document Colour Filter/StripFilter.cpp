@@ -0,0 +1,154 @@
+#include "StripFilter.h"
+#include "Image.h"
+#include "Histogram.h"
+#include "PageArena.h"
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cstring>
+
+StripFilter::StripFilter(int zoneSize, GreyConversion::FORMULA formula)
+{
+	this->zoneSize = zoneSize;
+	this->formula = formula;
+}
+
+double StripFilter::OriginalTonerUsage() const
+{
+	return (double)originalTonerSum / GreyPixel::maxValue;
+}
+
+double StripFilter::TonerUsage() const
+{
+	return (double)tonerSum / GreyPixel::maxValue;
+}
+
+bool StripFilter::Run(const std::string& input, const std::string& output)
+{
+	originalTonerSum = tonerSum = 0;
+	width = height = 0;
+
+	std::ifstream read(input, std::ios::binary);
+	if (!read)
+	{
+		if (Image::IsVerbose()) std::cout << "File " << input << " does not exist!" << std::endl;
+		return false;
+	}
+	BITMAPFILEHEADER file_header;
+	BITMAPINFOHEADER info_header;
+	read.read((char*)&file_header, sizeof(BITMAPFILEHEADER));
+	read.read((char*)&info_header, sizeof(BITMAPINFOHEADER));
+	if (!read || file_header.bfType != 0x4D42 || info_header.biBitCount != 24 || info_header.biCompression != 0 || info_header.biWidth <= 0 || info_header.biHeight <= 0)
+	{
+		if (Image::IsVerbose()) std::cout << input << " is not an uncompressed 24 bit BMP file!" << std::endl;
+		return false;
+	}
+
+	width = info_header.biWidth;
+	height = info_header.biHeight;
+	const std::uint64_t rowBytes = (std::uint64_t)width * 3;
+	const int extra = width % 4;   // Padding at the end of each row.
+	const std::uint64_t fileRowBytes = rowBytes + extra;
+
+	//The bands are the rows of the zone grid of the whole image, so every zone is processed exactly as in Image::FindAndDeleteBackgroundInZones.
+	//If the grid doesn't cover the image (or there is no grid at all) the rest is copied in zoneSize high bands without processing.
+	const ZoneGrid grid = ZoneGrid::FromZoneSize(zoneSize, 0, 0, width, height);
+	std::vector<unsigned long int> bandBounds(1, 0);
+	const unsigned long int processedBands = grid.GetRows();
+	for (unsigned long int j = 1; j <= processedBands; j++) bandBounds.push_back(grid.RowStart(j));
+	const unsigned long int step = zoneSize > 0 ? zoneSize : height;
+	while (bandBounds.back() < height) bandBounds.push_back(bandBounds.back() + step < height ? bandBounds.back() + step : height);
+
+	std::ofstream write(output, std::ios::binary);
+	if (!write)
+	{
+		if (Image::IsVerbose()) std::cout << "Failed to write " << output << std::endl;
+		return false;
+	}
+	const std::uint64_t outputSize = fileRowBytes * height + sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+	BITMAPFILEHEADER output_file_header = file_header;
+	output_file_header.bfSize = outputSize > 0xffffffff ? 0 : (DWORD)outputSize;     // Files over 4 GB can't store their size.
+	output_file_header.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+	BITMAPINFOHEADER output_info_header = info_header;
+	output_info_header.biSize = sizeof(BITMAPINFOHEADER);
+	output_info_header.biSizeImage = outputSize > 0xffffffff ? 0 : (DWORD)(fileRowBytes * height);
+	output_info_header.biClrUsed = 0;
+	output_info_header.biClrImportant = 0;
+	write.write((const char*)&output_file_header, sizeof(BITMAPFILEHEADER));
+	write.write((const char*)&output_info_header, sizeof(BITMAPINFOHEADER));
+
+	std::vector<char> inputBand;
+	std::vector<char> outputRow((std::size_t)fileRowBytes, 0);
+	//The pixels of every band come from the same arena, after the first band no memory is allocated.
+	PageArena arena(PixelPlane<GreyPixel>::AllocationSize(width, step));
+
+	//BMP stores the rows bottom-up, the bands are visited from the bottom of the image so both files are read and written sequentially.
+	for (unsigned long int b = (unsigned long int)bandBounds.size() - 1; b-- > 0;)
+	{
+		const unsigned long int top = bandBounds[b];
+		const unsigned long int bottom = bandBounds[b + 1];
+		const unsigned long int bandHeight = bottom - top;
+
+		inputBand.resize((std::size_t)(fileRowBytes * bandHeight));
+		read.seekg((std::streamoff)(file_header.bfOffBits + (std::uint64_t)(height - bottom) * fileRowBytes));
+		read.read(inputBand.data(), (std::streamsize)inputBand.size());
+		if (!read)
+		{
+			if (Image::IsVerbose()) std::cout << input << " is truncated!" << std::endl;
+			return false;
+		}
+
+		arena.Reset();
+		Image band(width, bandHeight);
+		band.UseArena(&arena);
+		band.greyFormula = formula;
+		band.SetBackgroundParameters(parameters);
+		if (!band.initGreyscale())
+		{
+			if (Image::IsVerbose()) std::cout << "Not enough memory to process " << input << std::endl;
+			return false;
+		}
+		std::fill_n(band.frequency, GreyPixel::maxValue + 1, 0);
+		Histogram::Accumulator accumulator;
+		for (unsigned long int k = 0; k < bandHeight; k++)
+		{
+			const RGBPixel* fileRow = (const RGBPixel*)(inputBand.data() + (bandHeight - 1 - k) * fileRowBytes);
+			GreyPixel* greyRow = band.greypixels.Row(k);
+			GreyConversion::ConvertRow(fileRow, greyRow, width, formula);
+			accumulator.Add(greyRow, width);
+		}
+		accumulator.AddTo(band.frequency);
+		band.frequencyValid = true;
+		band.SetPixelsumFromFrequency();
+		originalTonerSum += band.pixelsum;
+
+		if (b < processedBands)
+		{
+			for (unsigned long int i = 0; i < grid.GetColumns(); i++)
+			{
+				band.FindAndDeleteBackground(grid.ColumnStart(i), 0, grid.ColumnStart(i + 1), bandHeight);
+			}
+		}
+
+		for (unsigned long int k = bandHeight; k-- > 0;)
+		{
+			const GreyPixel* greyRow = band.greypixels.Row(k);
+			for (unsigned long int i = 0; i < width; i++)
+			{
+				const unsigned char luminance = greyRow[i].GetLuminance();
+				outputRow[3 * i] = outputRow[3 * i + 1] = outputRow[3 * i + 2] = luminance;
+				tonerSum += GreyPixel::maxValue - luminance;
+			}
+			write.write(outputRow.data(), (std::streamsize)outputRow.size());
+		}
+	}
+
+	write.close();
+	if (!write)
+	{
+		if (Image::IsVerbose()) std::cout << "Failed to write " << output << std::endl;
+		return false;
+	}
+	if (Image::IsVerbose()) std::cout << output << " file created." << std::endl;
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "GreyConversion.h"
+#include "BackgroundParameters.h"
+#include <string>
+#include <cstdint>
+
+/// <summary>
+/// Removes the background of a 24 bit BMP file without ever loading the whole image.
+/// The file is read, processed and written in horizontal bands of about zoneSize rows, so the memory used is
+/// proportional to width x zoneSize no matter how tall the image is. All file offsets and sizes are 64 bit.
+/// The result is the same as reading the file into an Image, calling FindAndDeleteBackgroundInZones(zoneSize) and WriteGreyscale.
+/// </summary>
+class StripFilter
+{
+private:
+	int zoneSize;
+	GreyConversion::FORMULA formula;
+	BackgroundParameters parameters;
+
+	unsigned long long int originalTonerSum = 0;
+	unsigned long long int tonerSum = 0;
+	unsigned long int width = 0;
+	unsigned long int height = 0;
+
+public:
+	/// <summary>
+	/// Constructor.
+	/// </summary>
+	/// <param name="zoneSize">The width and height of a single zone (and the height of a band).</param>
+	/// <param name="formula">The RGB to greyscale conversion formula.</param>
+	StripFilter(int zoneSize = 100, GreyConversion::FORMULA formula = GreyConversion::FORMULA::WEIGHTED);
+
+	/// <summary>
+	/// Removes the background of the input file and writes the greyscale result as a 24 bit BMP file.
+	/// </summary>
+	/// <param name="input">The path of the 24 bit BMP file to read.</param>
+	/// <param name="output">The path of the file to create.</param>
+	/// <returns>true if successful, false otherwise.</returns>
+	bool Run(const std::string& input, const std::string& output);
+
+	/// <summary>
+	/// Sets the background peak search window and falloff of the zones (see Image::SetBackgroundParameters).
+	/// </summary>
+	inline void SetBackgroundParameters(const BackgroundParameters& parameters) { this->parameters = parameters; }
+
+	/// <summary>
+	/// The dimensions of the image of the last Run, as read from its header. 0 if the header couldn't be read.
+	/// </summary>
+	inline unsigned long int GetWidth() const { return width; }
+	inline unsigned long int GetHeight() const { return height; }
+	/// <summary>
+	/// Toner units used for the original image of the last Run.
+	/// </summary>
+	double OriginalTonerUsage() const;
+	/// <summary>
+	/// Toner units used after removing the background in the last Run.
+	/// </summary>
+	double TonerUsage() const;
+};
@@ -0,0 +1,128 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+	if (threads == 0) threads = std::thread::hardware_concurrency();
+	if (threads == 0) threads = 1;
+	queued = 0;
+	nextQueue = 0;
+
+	//The calling thread is one of the threads, it uses queue 0 together with worker 0.
+	const unsigned int workerCount = threads - 1;
+	for (unsigned int i = 0; i < (workerCount > 0 ? workerCount : 1); i++) queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	for (unsigned int i = 0; i < workerCount; i++) workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers) worker.join();
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+bool ThreadPool::TryTake(std::size_t self, Task& task)
+{
+	//Own queue from the back: the most recently pushed task is the most likely to still be in the cache.
+	{
+		Queue& own = *queues[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty())
+		{
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			queued--;
+			return true;
+		}
+	}
+	//Steal from the front of the others.
+	for (std::size_t i = 1; i < queues.size(); i++)
+	{
+		Queue& victim = *queues[(self + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			queued--;
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::Execute(const Task& task)
+{
+	for (std::size_t i = task.begin; i < task.end; i++) (*task.job->task)(i);
+
+	const std::size_t count = task.end - task.begin;
+	if (task.job->remaining.fetch_sub(count) == count)
+	{
+		std::lock_guard<std::mutex> lock(task.job->mutex);
+		task.job->finished = true;
+		task.job->done.notify_all();
+	}
+}
+
+void ThreadPool::WorkerLoop(std::size_t self)
+{
+	while (true)
+	{
+		Task task;
+		if (TryTake(self, task))
+		{
+			Execute(task);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return stopping || queued > 0; });
+		if (stopping && queued == 0) return;
+	}
+}
+
+void ThreadPool::ParallelFor(std::size_t count, const std::function<void(std::size_t)>& task, std::size_t grain)
+{
+	if (count == 0) return;
+	if (workers.empty() || count == 1)
+	{
+		for (std::size_t i = 0; i < count; i++) task(i);
+		return;
+	}
+
+	//A few tasks per thread so the ones finishing early have something to steal.
+	if (grain == 0) grain = count / (4 * (std::size_t)GetThreadCount());
+	if (grain == 0) grain = 1;
+
+	Job job;
+	job.task = &task;
+	job.remaining = count;
+
+	std::size_t queue = nextQueue++;
+	for (std::size_t begin = 0; begin < count; begin += grain)
+	{
+		const std::size_t end = begin + grain < count ? begin + grain : count;
+		Queue& target = *queues[queue++ % queues.size()];
+		std::lock_guard<std::mutex> lock(target.mutex);
+		target.tasks.push_back(Task{ &job, begin, end });
+		queued++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+
+	//Help until every task of this job has been taken, then wait for the ones still running.
+	Task next;
+	while (job.remaining > 0 && TryTake(0, next)) Execute(next);
+
+	std::unique_lock<std::mutex> lock(job.mutex);
+	job.done.wait(lock, [&job] { return job.finished; });
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+
+/// <summary>
+/// A work-stealing thread pool.
+/// Every worker has its own queue of tasks, it takes from the back of its own queue and when that is empty it steals from the front of the others.
+/// The thread calling ParallelFor helps with the work until its own job is done, so ParallelFor can also be called from inside a task.
+/// </summary>
+class ThreadPool
+{
+private:
+	struct Job
+	{
+		const std::function<void(std::size_t)>* task;
+		std::atomic<std::size_t> remaining;
+		/// <summary>
+		/// Set under mutex by the thread finishing the last task, the job can only be destroyed after that.
+		/// </summary>
+		bool finished = false;
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+
+	/// <summary>
+	/// The indices [begin, end) of a job.
+	/// </summary>
+	struct Task
+	{
+		Job* job;
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<std::size_t> queued;
+	bool stopping = false;
+
+	std::atomic<std::size_t> nextQueue;
+
+	bool TryTake(std::size_t self, Task& task);
+	void Execute(const Task& task);
+	void WorkerLoop(std::size_t self);
+
+public:
+	/// <summary>
+	/// Constructor. Starts the worker threads.
+	/// </summary>
+	/// <param name="threads">The number of threads working on a job, including the calling thread. 0 means one per hardware thread.</param>
+	explicit ThreadPool(unsigned int threads = 0);
+	/// <summary>
+	/// Destructor. Waits for the workers to finish the queued tasks.
+	/// </summary>
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/// <summary>
+	/// The number of threads working on a job, including the calling thread.
+	/// </summary>
+	inline unsigned int GetThreadCount() const { return (unsigned int)workers.size() + 1; }
+
+	/// <summary>
+	/// Calls task(i) for every i in [0, count) and returns when all calls are finished.
+	/// The calls run in parallel in no particular order, they must not depend on each other.
+	/// </summary>
+	/// <param name="count">The number of calls.</param>
+	/// <param name="task">The function to call.</param>
+	/// <param name="grain">The number of consecutive indices in one task. 0 picks one based on count and the number of threads.</param>
+	void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& task, std::size_t grain = 0);
+
+	/// <summary>
+	/// A pool with one thread per hardware thread, shared by the whole process.
+	/// </summary>
+	static ThreadPool& Shared();
+};
@@ -0,0 +1,94 @@
+#include "TileHistograms.h"
+#include "ThreadPool.h"
+#include "PageArena.h"
+#include <algorithm>
+#include <atomic>
+
+void TileHistograms::Build(const PixelPlane<GreyPixel>& plane, const ZoneGrid& grid, ThreadPool* pool, PageArena* arena)
+{
+	columns = grid.GetColumns();
+	rows = grid.GetRows();
+	const std::size_t size = (std::size_t)GetZoneCount() * Histogram::size;
+	if (arena != nullptr)
+	{
+		counts = arena->AllocateArray<unsigned int>(size);
+		if (counts == nullptr) columns = rows = 0;
+	}
+	else
+	{
+		ownCounts.resize(size);     // Only allocates if the grid grew.
+		std::fill(ownCounts.begin(), ownCounts.end(), 0);
+		counts = ownCounts.data();
+	}
+
+	//One task per thread, every task takes the next row of zones until there are none left and reuses its own accumulators for it.
+	//The rows of zones write disjoint frequency arrays.
+	const std::size_t threads = pool != nullptr ? std::min<std::size_t>(pool->GetThreadCount(), rows) : 1;
+	const std::size_t accumulatorCount = AccumulatorCount(grid);
+	Histogram::Accumulator* accumulators = nullptr;
+	if (accumulatorCount > 0)
+	{
+		if (arena != nullptr)
+		{
+			accumulators = arena->AllocateArray<Histogram::Accumulator>(threads * accumulatorCount);
+			if (accumulators == nullptr)
+			{
+				columns = rows = 0;
+				return;
+			}
+		}
+		else
+		{
+			if (ownAccumulators.size() < threads * accumulatorCount) ownAccumulators.resize(threads * accumulatorCount);
+			accumulators = ownAccumulators.data();
+		}
+	}
+	std::atomic<std::size_t> next(0);
+	auto worker = [this, &plane, &grid, accumulators, accumulatorCount, &next](std::size_t t)
+	{
+		Histogram::Accumulator* own = accumulators != nullptr ? accumulators + t * accumulatorCount : nullptr;
+		for (std::size_t j = next++; j < rows; j = next++) CountZoneRow(plane, grid, (unsigned long int)j, &counts[j * columns * Histogram::size], own);
+	};
+	if (pool != nullptr && threads > 1) pool->ParallelFor(threads, worker, 1);
+	else worker(0);
+}
+
+unsigned long int TileHistograms::AccumulatorCount(const ZoneGrid& grid, unsigned int step)
+{
+	if (step == 0) step = 1;
+	//Tiny zones are counted directly, adding up the sub-histograms would cost more than the counting.
+	if (grid.GetZoneCount() == 0) return 0;
+	const unsigned long long int sampled = (unsigned long long int)(grid.ColumnStart(1) - grid.ColumnStart(0)) * (grid.RowStart(1) - grid.RowStart(0)) / ((unsigned long long int)step * step);
+	return sampled < 4 * Histogram::size ? 0 : grid.GetColumns();
+}
+
+void TileHistograms::CountZoneRow(const PixelPlane<GreyPixel>& plane, const ZoneGrid& grid, unsigned long int row, unsigned int* counts, Histogram::Accumulator* accumulators, unsigned int step)
+{
+	if (step == 0) step = 1;
+	//Every zone of the row is counted into its own sub-histograms first, the frequency arrays are written once per zone.
+	const unsigned long int columns = grid.GetColumns();
+	if (accumulators == nullptr || AccumulatorCount(grid, step) == 0)
+	{
+		for (unsigned long int y = grid.RowStart(row); y < grid.RowStart(row + 1); y += step)
+		{
+			const GreyPixel* pixels = plane.Row(y);
+			for (unsigned long int i = 0; i < columns; i++)
+			{
+				unsigned int* frequency = counts + i * Histogram::size;
+				if (step == 1) Histogram::CountRow(pixels + grid.ColumnStart(i), grid.ColumnStart(i + 1) - grid.ColumnStart(i), frequency);
+				else for (unsigned long int x = grid.ColumnStart(i); x < grid.ColumnStart(i + 1); x += step) frequency[pixels[x].GetLuminance()]++;
+			}
+		}
+		return;
+	}
+	for (unsigned long int i = 0; i < columns; i++) accumulators[i].Clear();
+	for (unsigned long int y = grid.RowStart(row); y < grid.RowStart(row + 1); y += step)
+	{
+		const GreyPixel* pixels = plane.Row(y);
+		for (unsigned long int i = 0; i < columns; i++)
+		{
+			accumulators[i].AddStrided(pixels + grid.ColumnStart(i), grid.ColumnStart(i + 1) - grid.ColumnStart(i), step);
+		}
+	}
+	for (unsigned long int i = 0; i < columns; i++) accumulators[i].AddTo(counts + i * Histogram::size);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "GreyPixel.h"
+#include "PixelPlane.h"
+#include "ZoneGrid.h"
+#include "Histogram.h"
+#include <vector>
+
+class ThreadPool;
+class PageArena;
+
+/// <summary>
+/// The grey shade frequencies of every zone of a ZoneGrid, built in a single pass over the pixels.
+/// All the frequency arrays live in one block that is kept (and reused) between builds.
+/// </summary>
+class TileHistograms
+{
+private:
+	/// <summary>
+	/// Histogram::size counts per zone, zones in row-major order.
+	/// </summary>
+	unsigned int* counts = nullptr;
+	/// <summary>
+	/// The block of counts when it is not allocated from an arena.
+	/// </summary>
+	std::vector<unsigned int> ownCounts;
+	/// <summary>
+	/// The accumulators of CountZoneRow, one set per thread, when they are not allocated from an arena.
+	/// </summary>
+	std::vector<Histogram::Accumulator> ownAccumulators;
+	unsigned long int columns = 0;
+	unsigned long int rows = 0;
+
+public:
+	/// <summary>
+	/// Counts the grey shades of every zone of the grid.
+	/// The rows are walked once from the first to the last, each row is split between the zones it crosses.
+	/// </summary>
+	/// <param name="plane">The greyscale pixels.</param>
+	/// <param name="grid">The zones.</param>
+	/// <param name="pool">If not nullptr the rows of zones are counted in parallel.</param>
+	/// <param name="arena">If not nullptr the block is allocated from it (valid until its Reset), otherwise the block of the previous build is reused.</param>
+	void Build(const PixelPlane<GreyPixel>& plane, const ZoneGrid& grid, ThreadPool* pool = nullptr, PageArena* arena = nullptr);
+
+	/// <summary>
+	/// The number of accumulators CountZoneRow needs for a row of zones of the grid: one per column, or 0 if the zones are so small that they are counted directly.
+	/// </summary>
+	static unsigned long int AccumulatorCount(const ZoneGrid& grid, unsigned int step = 1);
+	/// <summary>
+	/// Counts the grey shades of the zones of one row of zones, in a single pass over its rows.
+	/// Nothing is allocated, the caller provides the accumulators (and can reuse them for the next row).
+	/// </summary>
+	/// <param name="plane">The greyscale pixels.</param>
+	/// <param name="grid">The zones.</param>
+	/// <param name="row">The index of the row of zones.</param>
+	/// <param name="counts">Histogram::size counts for every zone of the row, added to.</param>
+	/// <param name="accumulators">AccumulatorCount(grid, step) accumulators, their content doesn't matter. nullptr if that is 0.</param>
+	/// <param name="step">Only every step-th pixel of every step-th row is counted (from the upper left corner of every zone), 1 in step * step pixels.</param>
+	static void CountZoneRow(const PixelPlane<GreyPixel>& plane, const ZoneGrid& grid, unsigned long int row, unsigned int* counts, Histogram::Accumulator* accumulators, unsigned int step = 1);
+
+	inline unsigned long int GetColumns() const { return columns; }
+	inline unsigned long int GetRows() const { return rows; }
+	inline unsigned long int GetZoneCount() const { return columns * rows; }
+
+	/// <summary>
+	/// The frequency array of zone (i, j).
+	/// </summary>
+	inline const unsigned int* Get(unsigned long int i, unsigned long int j) const { return &counts[((std::size_t)j * columns + i) * Histogram::size]; }
+	/// <summary>
+	/// The frequency array of the zone with the row-major index zone.
+	/// </summary>
+	inline const unsigned int* Get(std::size_t zone) const { return &counts[zone * Histogram::size]; }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+/// <summary>
+/// The toner usage of an image in toner units (a black pixel uses one unit, white uses none).
+/// </summary>
+struct TonerReport
+{
+	/// <summary>
+	/// The toner usage of one zone of the last zone based background removal.
+	/// </summary>
+	struct Zone
+	{
+		unsigned long int minWidth;
+		unsigned long int minHeight;
+		unsigned long int maxWidth;
+		unsigned long int maxHeight;
+		/// <summary>
+		/// Toner units the zone used before its background was removed.
+		/// </summary>
+		double original;
+		/// <summary>
+		/// Toner units saved by removing the background of the zone.
+		/// </summary>
+		double saved;
+	};
+
+	/// <summary>
+	/// Toner units used for the original image.
+	/// </summary>
+	double original = 0;
+	/// <summary>
+	/// Toner units used for the current greyscale pixels.
+	/// </summary>
+	double current = 0;
+	/// <summary>
+	/// The zones of the last FindAndDeleteBackgroundInZones or FindAndDeleteBackgroundInZonesWithZoneAmount call, in row-major order.
+	/// </summary>
+	std::vector<Zone> zones;
+
+	inline double Saved() const { return original - current; }
+	inline double SavedPercentage() const { return original > 0 ? Saved() / original * 100 : 0; }
+};
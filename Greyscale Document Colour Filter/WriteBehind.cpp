@@ -0,0 +1,83 @@
+#include "WriteBehind.h"
+#include <fstream>
+#include <cstring>
+#include <new>
+
+WriteBehind::WriteBehind(std::uint64_t maxBytes)
+{
+	this->maxBytes = maxBytes;
+	writer = std::thread(&WriteBehind::WriterLoop, this);
+}
+
+WriteBehind::~WriteBehind()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	submitted.notify_all();
+	writer.join();
+}
+
+void WriteBehind::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		submitted.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty()) return;     // Only stops after the queue is written.
+		File file = std::move(queue.front());
+		queue.pop_front();
+		writing = true;
+
+		lock.unlock();
+		std::ofstream stream(file.path, std::ios::binary);
+		const bool ok = stream && stream.write(file.contents.get(), (std::streamsize)file.size) && (stream.close(), !stream.fail());
+		file.contents.reset();
+		lock.lock();
+
+		if (!ok) failed.push_back(file.path);
+		queuedBytes -= file.size;
+		writing = false;
+		written.notify_all();
+	}
+}
+
+bool WriteBehind::Submit(const std::string& path, const char* contents, std::uint64_t size)
+{
+	//The room is reserved before copying, so the copies waiting for the queue don't use memory either.
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		written.wait(lock, [this, size] { return queuedBytes == 0 || queuedBytes + size <= maxBytes; });
+		queuedBytes += size;
+	}
+
+	File file;
+	file.path = path;
+	file.size = size;
+	file.contents.reset(new (std::nothrow) char[(std::size_t)size]);
+	const bool copied = file.contents != nullptr;
+	if (copied) std::memcpy(file.contents.get(), contents, (std::size_t)size);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (copied) queue.push_back(std::move(file));
+		else queuedBytes -= size;
+	}
+	if (!copied)
+	{
+		written.notify_all();
+		return false;
+	}
+	submitted.notify_one();
+	return true;
+}
+
+std::vector<std::string> WriteBehind::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	written.wait(lock, [this] { return queue.empty() && !writing; });
+	std::vector<std::string> result;
+	result.swap(failed);
+	return result;
+}
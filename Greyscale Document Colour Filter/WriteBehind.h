@@ -0,0 +1,66 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+/// <summary>
+/// Writes finished files on a background thread, so the next document can be processed while the previous one is written.
+/// The queued files use at most maxBytes of memory together (a single larger file is still queued), Submit waits when the queue is full.
+/// </summary>
+class WriteBehind
+{
+private:
+	struct File
+	{
+		std::string path;
+		std::unique_ptr<char[]> contents;
+		std::uint64_t size;
+	};
+
+	std::deque<File> queue;
+	std::uint64_t maxBytes;
+	std::uint64_t queuedBytes = 0;
+	bool writing = false;
+	bool stopping = false;
+	std::vector<std::string> failed;
+	std::mutex mutex;
+	std::condition_variable submitted;
+	std::condition_variable written;
+	std::thread writer;
+
+	void WriterLoop();
+
+public:
+	/// <summary>
+	/// Constructor. Starts the writer thread.
+	/// </summary>
+	/// <param name="maxBytes">The most memory the queued files use together.</param>
+	explicit WriteBehind(std::uint64_t maxBytes);
+	/// <summary>
+	/// Destructor. Writes every queued file, then stops the writer.
+	/// </summary>
+	~WriteBehind();
+
+	WriteBehind(const WriteBehind&) = delete;
+	WriteBehind& operator=(const WriteBehind&) = delete;
+
+	/// <summary>
+	/// Queues a copy of the contents to be written to path. Waits while the queue is full.
+	/// </summary>
+	/// <param name="path">The file to create (or overwrite).</param>
+	/// <param name="contents">The bytes of the file.</param>
+	/// <param name="size">The number of bytes.</param>
+	/// <returns>false if there isn't enough memory for the copy (nothing is queued).</returns>
+	bool Submit(const std::string& path, const char* contents, std::uint64_t size);
+	/// <summary>
+	/// Waits until every queued file is written.
+	/// </summary>
+	/// <returns>The paths that couldn't be written since the last Flush.</returns>
+	std::vector<std::string> Flush();
+};
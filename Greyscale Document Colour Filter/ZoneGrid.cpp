@@ -0,0 +1,40 @@
+#include "ZoneGrid.h"
+
+#include <math.h>
+
+void ZoneGrid::Build(double zoneSize, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	columnBounds.clear();
+	rowBounds.clear();
+	if (!(zoneSize > 0)) return;
+
+	unsigned long int cols = (unsigned long int)((maxWidth - minWidth) / zoneSize);
+	unsigned long int rows = (unsigned long int)((maxHeight - minHeight) / zoneSize);
+	if (cols == 0 || rows == 0) return;
+
+	//The zones are stretched so they cover the whole region.
+	double zoneWidth = double(maxWidth - minWidth) / cols;
+	double zoneHeight = double(maxHeight - minHeight) / rows;
+
+	columnBounds.resize(cols + 1);
+	for (unsigned long int i = 0; i <= cols; i++) columnBounds[i] = minWidth + (unsigned long int)floor((double)i * zoneWidth);
+	rowBounds.resize(rows + 1);
+	for (unsigned long int j = 0; j <= rows; j++) rowBounds[j] = minHeight + (unsigned long int)floor((double)j * zoneHeight);
+}
+
+ZoneGrid ZoneGrid::FromZoneSize(int zoneSize, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	ZoneGrid grid;
+	grid.Build(zoneSize, minWidth, minHeight, maxWidth, maxHeight);
+	return grid;
+}
+
+ZoneGrid ZoneGrid::FromZoneAmount(int zones, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	ZoneGrid grid;
+	if (zones <= 0) return grid;
+	unsigned long long int imageArea = (long long)(maxWidth - minWidth) * (long long)(maxHeight - minHeight);
+	double zoneArea = (double)imageArea / zones;
+	grid.Build(sqrt(zoneArea), minWidth, minHeight, maxWidth, maxHeight);
+	return grid;
+}
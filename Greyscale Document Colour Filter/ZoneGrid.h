@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+
+/// <summary>
+/// The rectangular zones a region of an image is divided into for local thresholding.
+/// Zone (i, j) spans the columns ColumnStart(i) - ColumnStart(i + 1) and the rows RowStart(j) - RowStart(j + 1).
+/// </summary>
+class ZoneGrid
+{
+private:
+	/// <summary>
+	/// cols + 1 column boundaries and rows + 1 row boundaries.
+	/// </summary>
+	std::vector<unsigned long int> columnBounds;
+	std::vector<unsigned long int> rowBounds;
+
+	void Build(double zoneSize, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight);
+
+public:
+	/// <summary>
+	/// Divides the region into zones close to the size of zoneSize x zoneSize.
+	/// </summary>
+	static ZoneGrid FromZoneSize(int zoneSize, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight);
+	/// <summary>
+	/// Divides the region into about zones amount of zones.
+	/// </summary>
+	static ZoneGrid FromZoneAmount(int zones, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight);
+
+	inline unsigned long int GetColumns() const { return columnBounds.empty() ? 0 : (unsigned long int)columnBounds.size() - 1; }
+	inline unsigned long int GetRows() const { return rowBounds.empty() ? 0 : (unsigned long int)rowBounds.size() - 1; }
+	inline unsigned long int GetZoneCount() const { return GetColumns() * GetRows(); }
+
+	inline unsigned long int ColumnStart(unsigned long int i) const { return columnBounds[i]; }
+	inline unsigned long int RowStart(unsigned long int j) const { return rowBounds[j]; }
+};
@@ -0,0 +1,350 @@
+#include "Image.h"
+#include "SyntheticDocument.h"
+#include "GreyConversion.h"
+#include "ParameterSweep.h"
+#include "ThreadPool.h"
+#include "ZoneGrid.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+
+//Checks the optimized paths against straightforward implementations and the file formats against what was written.
+//Usage: Tests (the exit code is 0 if every check passed, 1 otherwise)
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string& what)
+{
+	if (condition) return;
+	failures++;
+	std::cout << "FAILED: " << what << std::endl;
+}
+
+/// <summary>
+/// A path in the temporary directory for a file of the tests.
+/// </summary>
+static std::string TempPath(const std::string& name)
+{
+	return (std::filesystem::temp_directory_path() / ("GreyscaleTests-" + name)).string();
+}
+
+/// <summary>
+/// Writes a synthetic document of the given size as a 24 bit BMP file and reads it back in mode.
+/// </summary>
+static Image MakeDocument(unsigned long int width, unsigned long int height, Image::READMODE mode, unsigned int seed = 1)
+{
+	SyntheticDocument::Options options;
+	options.width = width;
+	options.height = height;
+	options.seed = seed;
+	options.textDensity = 0.4;
+	const std::string path = TempPath("document.bmp");
+	if (!SyntheticDocument::Write(path, options)) return Image();
+	Image document(path, mode);
+	std::remove(path.c_str());
+	return document;
+}
+
+static bool SameGrey(const PixelPlane<GreyPixel>& a, const PixelPlane<GreyPixel>& b)
+{
+	if (a.IsEmpty() || a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight()) return false;
+	for (unsigned long int j = 0; j < a.GetHeight(); j++)
+	{
+		if (std::memcmp(a.Row(j), b.Row(j), a.GetWidth() * sizeof(GreyPixel)) != 0) return false;
+	}
+	return true;
+}
+
+static bool SameColour(const PixelPlane<RGBPixel>& a, const PixelPlane<RGBPixel>& b)
+{
+	if (a.IsEmpty() || a.GetWidth() != b.GetWidth() || a.GetHeight() != b.GetHeight()) return false;
+	for (unsigned long int j = 0; j < a.GetHeight(); j++)
+	{
+		if (std::memcmp(a.Row(j), b.Row(j), a.GetWidth() * sizeof(RGBPixel)) != 0) return false;
+	}
+	return true;
+}
+
+/// <summary>
+/// The greyscale pixels of source with every shade replaced by map(shade).
+/// </summary>
+template <class Map>
+static Image MapGrey(const Image& source, Map map)
+{
+	const PixelPlane<GreyPixel>& pixels = source.GetGreyPixels();
+	Image expected(pixels.GetWidth(), pixels.GetHeight());
+	PixelPlane<GreyPixel>& mapped = expected.GetGreyPixels();
+	mapped.Allocate(pixels.GetWidth(), pixels.GetHeight());
+	for (unsigned long int j = 0; j < pixels.GetHeight(); j++)
+	{
+		for (unsigned long int i = 0; i < pixels.GetWidth(); i++) mapped(i, j) = GreyPixel(map(pixels(i, j).GetLuminance()));
+	}
+	return expected;
+}
+
+//The widths cover every padding of BMP rows (4 byte multiples) and of the 1 and 4 bit packing, the heights are odd too.
+static const unsigned long int widths[] = { 1, 2, 3, 5, 7, 8, 9, 13, 15, 17, 31, 33, 63, 65, 127, 255, 257, 301 };
+static const unsigned long int height = 23;
+
+/// <summary>
+/// Writes the greyscale pixels of document with write, reads the file back and compares it with expected.
+/// </summary>
+template <class Write>
+static void RoundTrip(Image& document, const char* name, const std::string& extension, Write write, const Image& expected)
+{
+	const std::string path = TempPath(name + extension);
+	const std::string what = std::string(name) + " round trip at width " + std::to_string(document.GetWidth());
+	Check(write(document, path), what + ": writing failed");
+	const Image read(path, Image::READMODE::GREYSCALE);
+	Check(read.GetWidth() == document.GetWidth() && read.GetHeight() == document.GetHeight(), what + ": wrong size");
+	Check(SameGrey(read.GetGreyPixels(), expected.GetGreyPixels()), what + ": wrong pixels");
+	std::remove(path.c_str());
+}
+
+static void TestIndexedBMP()
+{
+	for (unsigned long int width : widths)
+	{
+		Image document = MakeDocument(width, height, Image::READMODE::FUSED);
+		RoundTrip(document, "BMP8", ".bmp", [](Image& image, const std::string& path) { return image.WriteBMP8Greyscale(path); }, document);
+		//The threshold is in the noise of the paper, so there are shades right at it.
+		document.SetBilevelThreshold(GreyPixel(220));
+		const Image bilevel = MapGrey(document, [](unsigned char shade) { return shade >= 220 ? 255 : 0; });
+		RoundTrip(document, "BMP1", ".bmp", [](Image& image, const std::string& path) { return image.WriteBMP1Greyscale(path); }, bilevel);
+	}
+}
+
+static void TestRunLength()
+{
+	//The documents are encoded as read (mostly short runs of noise) and with the background removed (long runs of white).
+	for (unsigned long int width : widths)
+	{
+		for (int removed = 0; removed < 2; removed++)
+		{
+			Image document = MakeDocument(width, height, Image::READMODE::FUSED);
+			if (removed) document.FindAndDeleteBackground();
+			RoundTrip(document, "RLE8", ".bmp", [](Image& image, const std::string& path) { return image.WriteRLE8Greyscale(path); }, document);
+			const Image quantized = MapGrey(document, [](unsigned char shade) { return (shade + 8) / 17 * 17; });
+			RoundTrip(document, "RLE4", ".bmp", [](Image& image, const std::string& path) { return image.WriteRLE4Greyscale(path); }, quantized);
+		}
+	}
+}
+
+static void TestNetpbm()
+{
+	for (unsigned long int width : widths)
+	{
+		Image document = MakeDocument(width, height, Image::READMODE::FUSED);
+		RoundTrip(document, "PGM", ".pgm", [](Image& image, const std::string& path) { return image.WritePGM(path); }, document);
+		document.SetBilevelThreshold(GreyPixel(220));
+		const Image bilevel = MapGrey(document, [](unsigned char shade) { return shade >= 220 ? 255 : 0; });
+		RoundTrip(document, "PBM", ".pbm", [](Image& image, const std::string& path) { return image.WritePBM(path); }, bilevel);
+
+		const std::string path = TempPath("PPM.ppm");
+		Check(document.WritePPM(path), "PPM round trip at width " + std::to_string(width) + ": writing failed");
+		const Image read(path, Image::READMODE::RGB);
+		Check(SameColour(read.GetColourPixels(), document.GetColourPixels()), "PPM round trip at width " + std::to_string(width) + ": wrong pixels");
+		std::remove(path.c_str());
+	}
+}
+
+static void TestConversion()
+{
+	//Random colours, with the extremes of every channel at the start, at every length up to a few SIMD blocks and at every misalignment.
+	std::mt19937 random(7);
+	std::uniform_int_distribution<int> channel(0, 255);
+	std::vector<RGBPixel> colours(4096 + 64);
+	for (std::size_t i = 0; i < colours.size(); i++) colours[i] = RGBPixel((unsigned char)channel(random), (unsigned char)channel(random), (unsigned char)channel(random));
+	for (int i = 0; i < 8; i++) colours[i] = RGBPixel(i & 1 ? 255 : 0, i & 2 ? 255 : 0, i & 4 ? 255 : 0);
+
+	struct Formula
+	{
+		GreyConversion::FORMULA formula;
+		const char* name;
+		unsigned char (*convert)(const RGBPixel& colour);
+	};
+	const Formula formulas[] =
+	{
+		{ GreyConversion::FORMULA::WEIGHTED, "weighted", [](const RGBPixel& c) { return GreyConversion::Weighted(c.Red(), c.Green(), c.Blue()); } },
+		{ GreyConversion::FORMULA::AVERAGE, "average", [](const RGBPixel& c) { return GreyConversion::Average(c.Red(), c.Green(), c.Blue()); } },
+		{ GreyConversion::FORMULA::REC601, "rec601", [](const RGBPixel& c) { return (unsigned char)((9798 * c.Red() + 19235 * c.Green() + 3735 * c.Blue()) >> GreyConversion::weightShift); } },
+		{ GreyConversion::FORMULA::RED, "red", [](const RGBPixel& c) { return c.Red(); } },
+		{ GreyConversion::FORMULA::GREEN, "green", [](const RGBPixel& c) { return c.Green(); } },
+		{ GreyConversion::FORMULA::BLUE, "blue", [](const RGBPixel& c) { return c.Blue(); } },
+	};
+
+	const GreyConversion::INSTRUCTIONSET supported = GreyConversion::GetSupportedInstructionSet();
+	std::vector<GreyPixel> grey(colours.size());
+	for (int set = (int)GreyConversion::INSTRUCTIONSET::SCALAR; set <= (int)supported; set++)
+	{
+		GreyConversion::SetInstructionSet((GreyConversion::INSTRUCTIONSET)set);
+		const std::string instructionSet = GreyConversion::InstructionSetName((GreyConversion::INSTRUCTIONSET)set);
+		for (const Formula& formula : formulas)
+		{
+			for (std::size_t offset = 0; offset < 4; offset++)
+			{
+				for (std::size_t count : { 0, 1, 2, 3, 7, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 95, 127, 129, 1000, 4096 })
+				{
+					std::fill(grey.begin(), grey.end(), GreyPixel(1));
+					GreyConversion::ConvertRow(&colours[offset], &grey[offset], count, formula.formula);
+					bool same = true;
+					for (std::size_t i = 0; i < count; i++) same = same && grey[offset + i].GetLuminance() == formula.convert(colours[offset + i]);
+					//Nothing is written past the row.
+					same = same && grey[offset + count].GetLuminance() == 1;
+					Check(same, std::string(formula.name) + " conversion with " + instructionSet + " of " + std::to_string(count) + " pixels at offset " + std::to_string(offset));
+				}
+			}
+		}
+	}
+	GreyConversion::SetInstructionSet(supported);
+
+	//The compile-time formulas are the same as the runtime ones.
+	std::vector<GreyPixel> specialized(colours.size());
+	GreyConversion::ConvertRow(colours.data(), grey.data(), colours.size(), GreyConversion::FORMULA::WEIGHTED);
+	GreyConversion::ConvertRow<GreyConversion::Rec709>(colours.data(), specialized.data(), colours.size());
+	Check(std::memcmp(grey.data(), specialized.data(), grey.size()) == 0, "Rec709 policy against the weighted formula");
+	GreyConversion::ConvertRow(colours.data(), grey.data(), colours.size(), GreyConversion::FORMULA::REC601);
+	GreyConversion::ConvertRow<GreyConversion::Rec601>(colours.data(), specialized.data(), colours.size());
+	Check(std::memcmp(grey.data(), specialized.data(), grey.size()) == 0, "Rec601 policy against the rec601 formula");
+	GreyConversion::ConvertRow(colours.data(), grey.data(), colours.size(), GreyConversion::FORMULA::AVERAGE);
+	GreyConversion::ConvertRow<GreyConversion::Average3>(colours.data(), specialized.data(), colours.size());
+	Check(std::memcmp(grey.data(), specialized.data(), grey.size()) == 0, "Average3 policy against the average formula");
+}
+
+/// <summary>
+/// The sliding window removal done the slow way: the histogram of every window is counted from the original shades.
+/// </summary>
+static Image SlidingBruteForce(const Image& document, int windowSize, const BackgroundParameters& parameters, unsigned long int minWidth, unsigned long int minHeight, unsigned long int maxWidth, unsigned long int maxHeight)
+{
+	const PixelPlane<GreyPixel>& original = document.GetGreyPixels();
+	Image expected(document);
+	PixelPlane<GreyPixel>& pixels = expected.GetGreyPixels();
+	const long int radius = windowSize / 2;
+	for (long int y = (long int)minHeight; y < (long int)maxHeight; y++)
+	{
+		for (long int x = (long int)minWidth; x < (long int)maxWidth; x++)
+		{
+			unsigned int frequency[256] = {};
+			for (long int j = std::max(y - radius, (long int)minHeight); j <= std::min(y + radius, (long int)maxHeight - 1); j++)
+			{
+				for (long int i = std::max(x - radius, (long int)minWidth); i <= std::min(x + radius, (long int)maxWidth - 1); i++) frequency[original(i, j).GetLuminance()]++;
+			}
+			if (original(x, y).GetLuminance() >= Image::FindBackgroundStart(frequency, parameters).GetLuminance()) pixels(x, y) = GreyPixel::White();
+		}
+	}
+	return expected;
+}
+
+static void TestSliding()
+{
+	struct Case
+	{
+		unsigned long int width, height;
+		int windowSize;
+		unsigned int threads;
+		double percent;
+		bool region;
+	};
+	//Windows wider than the page, even and odd window sizes, a single band and several bands (4 window heights each at least), a region inside the page.
+	const Case cases[] =
+	{
+		{ 61, 47, 7, 1, 0.15, false },
+		{ 61, 47, 8, 1, 0.05, true },
+		{ 37, 250, 9, 4, 0.15, false },
+		{ 53, 300, 5, 3, 0.3, true },
+		{ 20, 30, 101, 1, 0.15, false },
+		{ 1, 90, 3, 2, 0.15, false },
+	};
+	for (const Case& test : cases)
+	{
+		Image document = MakeDocument(test.width, test.height, Image::READMODE::GREYSCALE, 3);
+		BackgroundParameters parameters;
+		parameters.percent = test.percent;
+		document.SetBackgroundParameters(parameters);
+		document.SetThreadCount(test.threads);
+		const unsigned long int minWidth = test.region ? test.width / 5 : 0;
+		const unsigned long int minHeight = test.region ? test.height / 7 : 0;
+		const unsigned long int maxWidth = test.region ? test.width - test.width / 6 : test.width;
+		const unsigned long int maxHeight = test.region ? test.height - test.height / 9 : test.height;
+		const Image expected = SlidingBruteForce(document, test.windowSize, parameters, minWidth, minHeight, maxWidth, maxHeight);
+		document.FindAndDeleteBackgroundSliding(test.windowSize, minWidth, minHeight, maxWidth, maxHeight);
+		Check(SameGrey(document.GetGreyPixels(), expected.GetGreyPixels()), "sliding window " + std::to_string(test.windowSize) + " on " + std::to_string(test.width) + "x" + std::to_string(test.height)
+			+ " with " + std::to_string(test.threads) + " threads against counting every window");
+	}
+}
+
+static unsigned long long int TonerSum(const PixelPlane<GreyPixel>& pixels)
+{
+	unsigned long long int sum = 0;
+	for (unsigned long int j = 0; j < pixels.GetHeight(); j++)
+	{
+		for (unsigned long int i = 0; i < pixels.GetWidth(); i++) sum += GreyPixel::maxValue - pixels(i, j).GetLuminance();
+	}
+	return sum;
+}
+
+static void TestSweep()
+{
+	const Image document = MakeDocument(413, 389, Image::READMODE::GREYSCALE, 5);
+	const PixelPlane<GreyPixel>& original = document.GetGreyPixels();
+	BackgroundParameters narrow;
+	narrow.peakMin = 190;
+	narrow.peakMax = 256;
+	ParameterSweep sweep;
+	sweep.AddGrid({ 16, 50, 97, 1000 }, { 0.015, 0.15, 0.5 }, { BackgroundParameters(), narrow });
+
+	ThreadPool pool(4);
+	for (ThreadPool* threads : { (ThreadPool*)nullptr, &pool })
+	{
+		Image evaluated(document);
+		const std::vector<ParameterSweep::Result> results = sweep.Run(evaluated, threads);
+		Check(results.size() == sweep.GetCombinationCount(), "sweep result count");
+		Check(SameGrey(evaluated.GetGreyPixels(), original), "the sweep changed the pixels");
+		for (const ParameterSweep::Result& result : results)
+		{
+			//The real run of the same setting on a copy.
+			Image removed(document);
+			removed.SetBackgroundParameters(result.combination.parameters);
+			removed.FindAndDeleteBackgroundInZones(result.combination.zoneSize);
+			const PixelPlane<GreyPixel>& pixels = removed.GetGreyPixels();
+			unsigned long long int inked = 0, whitened = 0;
+			for (unsigned long int j = 0; j < pixels.GetHeight(); j++)
+			{
+				for (unsigned long int i = 0; i < pixels.GetWidth(); i++)
+				{
+					if (original(i, j).GetLuminance() == GreyPixel::maxValue) continue;
+					inked++;
+					if (pixels(i, j).GetLuminance() == GreyPixel::maxValue) whitened++;
+				}
+			}
+			const unsigned long long int before = TonerSum(original);
+			const unsigned long long int after = TonerSum(pixels);
+			const std::string what = "sweep of zone size " + std::to_string(result.combination.zoneSize) + ", percent " + std::to_string(result.combination.parameters.percent)
+				+ ", peak search from " + std::to_string(result.combination.parameters.peakMin) + (threads != nullptr ? " in parallel" : "");
+			Check(result.zones == ZoneGrid::FromZoneSize(result.combination.zoneSize, 0, 0, document.GetWidth(), document.GetHeight()).GetZoneCount(), what + ": zone count");
+			Check(result.originalToner == (double)before / GreyPixel::maxValue, what + ": original toner");
+			Check(result.savedToner == (double)(before - after) / GreyPixel::maxValue, what + ": saved toner against the real run");
+			Check(result.inkedPixels == inked, what + ": inked pixels");
+			Check(result.removedPixels == whitened, what + ": removed pixels against the real run");
+		}
+	}
+}
+
+int main()
+{
+	Image::SetVerbose(false);
+	TestIndexedBMP();
+	TestRunLength();
+	TestNetpbm();
+	TestConversion();
+	TestSliding();
+	TestSweep();
+	if (failures == 0) std::cout << "All tests passed." << std::endl;
+	else std::cout << failures << " checks failed." << std::endl;
+	return failures == 0 ? 0 : 1;
+}